@@ -0,0 +1,188 @@
+#ifndef CB_COMMON_BATCH_QUEUE_HPP_
+#define CB_COMMON_BATCH_QUEUE_HPP_
+
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+#include "include/cb/common/ring_buffer.hpp"
+
+namespace cb {
+namespace common {
+
+// a RingBuffer with the hand-off between its producers and consumer threads:
+// producers push without a lock and wake a consumer only when one sleeps,
+// consumers run consume() until stop() and the queue is empty.
+//   BatchQueue<Rec> queue(8192);
+//   std::thread th([&]() { queue.consume([&](bool stop) { ...pop a batch...; return n; }, []() { return interval; }); });
+//   queue.push(rec);
+//   queue.stop(); th.join();
+template <typename T>
+class BatchQueue {
+ public:
+  explicit BatchQueue(std::size_t capacity);
+  ~BatchQueue(void);
+  BatchQueue(const BatchQueue& rhs) = delete;
+  BatchQueue& operator =(const BatchQueue& rhs) = delete;
+
+  // false: full, or stopped
+  bool push(const T& v);
+  bool push(T&& v);
+  // waits for a consumer to make room
+  void pushWait(const T& v);
+  bool pop(T& v);
+  // consumers finish what's queued and return
+  void stop(void);
+  bool stopped(void) const;
+
+  // batch(stop) handles what it pops and returns how many, 0 sends the thread to sleep up to idle() msec.
+  // stop: stop() was called before the batch started, anything pushed ahead of it is still in the queue
+  template <typename Batch, typename Idle>
+  void consume(Batch batch, Idle idle);
+
+  std::size_t capacity(void) const;
+  std::size_t size(void) const; // approximate under contention
+
+ private:
+  void wake(void);
+
+ private:
+  RingBuffer<T> m_queue;
+  std::atomic<bool> m_stop;
+  std::atomic<unsigned int> m_idle; // consumers waiting on m_cv_data
+  std::atomic<unsigned int> m_blocked; // producers waiting on m_cv_space
+  std::mutex m_cv_mtx;
+  std::condition_variable m_cv_data;
+  std::condition_variable m_cv_space;
+};
+
+template <typename T>
+BatchQueue<T>::BatchQueue(std::size_t capacity) :
+  m_queue(capacity),
+  m_stop(false),
+  m_idle(0),
+  m_blocked(0)
+{
+}
+
+template <typename T>
+BatchQueue<T>::~BatchQueue(void) {
+}
+
+template <typename T>
+bool BatchQueue<T>::push(const T& v) {
+  if (m_stop.load() == true || m_queue.push(v) == false) {
+    return false;
+  }
+  wake();
+
+  return true;
+}
+
+template <typename T>
+bool BatchQueue<T>::push(T&& v) {
+  if (m_stop.load() == true || m_queue.push(std::move(v)) == false) {
+    return false;
+  }
+  wake();
+
+  return true;
+}
+
+template <typename T>
+void BatchQueue<T>::pushWait(const T& v) {
+  if (m_queue.push(v) == false) {
+    m_blocked.fetch_add(1);
+    {
+      std::unique_lock<std::mutex> lock(m_cv_mtx);
+      while (m_queue.push(v) == false) {
+        m_cv_data.notify_one();
+        m_cv_space.wait_for(lock, std::chrono::milliseconds(1));
+      }
+    }
+    m_blocked.fetch_sub(1);
+  }
+  wake();
+}
+
+template <typename T>
+bool BatchQueue<T>::pop(T& v) {
+  if (m_queue.pop(v) == false) {
+    return false;
+  }
+  if (m_blocked.load() > 0) {
+    m_cv_space.notify_all();
+  }
+
+  return true;
+}
+
+template <typename T>
+void BatchQueue<T>::stop(void) {
+  m_stop.store(true);
+
+  std::lock_guard<std::mutex> lock(m_cv_mtx);
+  m_cv_data.notify_all();
+}
+
+template <typename T>
+bool BatchQueue<T>::stopped(void) const {
+  return m_stop.load();
+}
+
+template <typename T>
+template <typename Batch, typename Idle>
+void BatchQueue<T>::consume(Batch batch, Idle idle) {
+  bool stop;
+
+  for (;;) {
+    // read before popping, so nothing pushed ahead of the stop is missed
+    stop = m_stop.load();
+
+    if (batch(stop) > 0) {
+      continue;
+    }
+    if (stop == true) {
+      // producers are gone and the queue is empty
+      break;
+    }
+
+    std::chrono::milliseconds wait = idle();
+    std::unique_lock<std::mutex> lock(m_cv_mtx);
+    m_idle.fetch_add(1);
+    // pairs with wake(): either the producer sees us idle or we see its element
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_queue.size() == 0 && m_stop.load() == false) {
+      m_cv_data.wait_for(lock, wait);
+    }
+    m_idle.fetch_sub(1);
+  }
+}
+
+// the push before the load, see consume()
+template <typename T>
+void BatchQueue<T>::wake(void) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (m_idle.load() > 0) {
+    std::lock_guard<std::mutex> lock(m_cv_mtx);
+    m_cv_data.notify_one();
+  }
+}
+
+template <typename T>
+std::size_t BatchQueue<T>::capacity(void) const {
+  return m_queue.capacity();
+}
+
+template <typename T>
+std::size_t BatchQueue<T>::size(void) const {
+  return m_queue.size();
+}
+
+} // namespace common
+} // namespace cb
+
+#endif
@@ -3,6 +3,8 @@
 
 // YYYY-MM-DDTHH:MM:SS.sssZ
 #define CB_DEFINES_H_LEN_ISO8601 25
+// Www, DD Mmm YYYY HH:MM:SS GMT
+#define CB_DEFINES_H_LEN_HTTPDATE 30
 
 # if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
 #   include <Windows.h>
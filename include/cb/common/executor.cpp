@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+#include "include/cb/common/logger.h"
+#include "include/cb/common/executor.h"
+
+namespace cb {
+namespace common {
+
+Executor::Executor(unsigned int threads, unsigned int capacity) :
+  m_queue(capacity),
+  m_rejected(0)
+{
+  if (threads == 0) {
+    threads = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  }
+
+  for (unsigned int i = 0; i < threads; ++i) {
+    m_workers.emplace_back(new std::thread([this]() {
+      work();
+    }));
+  }
+}
+
+Executor::~Executor(void) {
+  stop();
+}
+
+void Executor::stop(void) {
+  m_queue.stop();
+  for (auto it = m_workers.begin(); it != m_workers.end(); ++it) {
+    if ((*it)->joinable() == true) {
+      (*it)->join();
+    }
+  }
+}
+
+bool Executor::post(task_t task) {
+  if (m_queue.push(std::move(task)) == false) {
+    m_rejected.fetch_add(1);
+    return false;
+  }
+
+  return true;
+}
+
+unsigned int Executor::threads(void) const {
+  return static_cast<unsigned int>(m_workers.size());
+}
+
+std::size_t Executor::pending(void) const {
+  return m_queue.size();
+}
+
+unsigned long long Executor::rejected(void) const {
+  return m_rejected.load();
+}
+
+void Executor::work(void) {
+  task_t task;
+  const char* function = __FUNCTION__;
+
+  m_queue.consume([this, &task, function](bool /*stop*/) -> unsigned int {
+    if (m_queue.pop(task) == false) {
+      return 0;
+    }
+    try {
+      task();
+    } catch (std::exception& err) {
+      CB_LOGF_ERROR("{}:{}: {}", function, __LINE__, err.what());
+    }
+    task = nullptr;
+
+    return 1;
+  }, []() {
+    return std::chrono::milliseconds(CB_COMMON_EXECUTOR_H_INTERVAL);
+  });
+}
+
+} // namespace common
+} // namespace cb
@@ -0,0 +1,53 @@
+#ifndef CB_COMMON_EXECUTOR_H_
+#define CB_COMMON_EXECUTOR_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "include/cb/common/batch_queue.hpp"
+
+#define CB_COMMON_EXECUTOR_H_LEN_QUEUE 1024
+#define CB_COMMON_EXECUTOR_H_INTERVAL 100 // msec, an idle worker rechecks the queue
+
+namespace cb {
+namespace common {
+
+// fixed worker threads over a bounded queue.
+// post() never blocks: a task that doesn't fit is refused, and the caller sheds the load (e.g. answers 503).
+class Executor {
+ public:
+  typedef std::function<void()> task_t;
+
+  // threads: 0 picks one per hardware thread
+  explicit Executor(unsigned int threads = 0, unsigned int capacity = CB_COMMON_EXECUTOR_H_LEN_QUEUE);
+  ~Executor(void);
+  Executor(const Executor& rhs) = delete;
+  Executor& operator =(const Executor& rhs) = delete;
+
+  // false: the queue is full (or stopping), task is dropped
+  bool post(task_t task);
+  // runs what's queued, then joins the workers. post() refuses everything after
+  void stop(void);
+
+  unsigned int threads(void) const;
+  // approximate
+  std::size_t pending(void) const;
+  // tasks refused by post()
+  unsigned long long rejected(void) const;
+
+ private:
+  void work(void);
+
+ private:
+  BatchQueue<task_t> m_queue;
+  std::atomic<unsigned long long> m_rejected;
+  std::vector<std::unique_ptr<std::thread>> m_workers;
+};
+
+} // namespace common
+} // namespace cb
+
+#endif
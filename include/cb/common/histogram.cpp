@@ -0,0 +1,228 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+#include "include/cb/common/histogram.h"
+
+namespace {
+
+// round-robin shard per thread
+std::atomic<unsigned int> shard_next(0);
+
+unsigned int shardId(void) {
+  static thread_local unsigned int rtn = shard_next.fetch_add(1, std::memory_order_relaxed);
+
+  return rtn;
+}
+
+unsigned int msb(unsigned long long v) {
+#if defined(__GNUC__) || defined(__clang__)
+  return 63 - __builtin_clzll(v | 1);
+#else
+  unsigned int rtn = 0;
+  while (v >>= 1) {
+    ++rtn;
+  }
+  return rtn;
+#endif
+}
+
+void storeMin(std::atomic<unsigned long long>& slot, unsigned long long v) {
+  unsigned long long curr = slot.load(std::memory_order_relaxed);
+  while (v < curr && slot.compare_exchange_weak(curr, v, std::memory_order_relaxed) == false) {
+  }
+}
+
+void storeMax(std::atomic<unsigned long long>& slot, unsigned long long v) {
+  unsigned long long curr = slot.load(std::memory_order_relaxed);
+  while (v > curr && slot.compare_exchange_weak(curr, v, std::memory_order_relaxed) == false) {
+  }
+}
+
+} // namespace
+
+namespace cb {
+namespace common {
+
+Histogram::Histogram(unsigned int shards) {
+  if (shards == 0) {
+    shards = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  }
+  shards = std::min<unsigned int>(shards, CB_COMMON_HISTOGRAM_H_LEN_SHARDS);
+
+  for (unsigned int i = 0; i < shards; ++i) {
+    m_shards.emplace_back(new tagShard);
+  }
+  reset();
+}
+
+Histogram::~Histogram(void) {
+}
+
+std::size_t Histogram::index(unsigned long long value) {
+  unsigned int bits = msb(value);
+
+  if (bits < CB_COMMON_HISTOGRAM_H_SUB_BITS) {
+    return static_cast<std::size_t>(value);
+  }
+
+  // the top SUB_BITS bits of value, shifted into their power of two
+  unsigned int shift = bits - CB_COMMON_HISTOGRAM_H_SUB_BITS + 1;
+
+  return static_cast<std::size_t>(shift) * (CB_COMMON_HISTOGRAM_H_LEN_SUB / 2) + static_cast<std::size_t>(value >> shift);
+}
+
+unsigned long long Histogram::lowest(std::size_t index) {
+  if (index < CB_COMMON_HISTOGRAM_H_LEN_SUB) {
+    return index;
+  }
+
+  unsigned int shift = static_cast<unsigned int>(index / (CB_COMMON_HISTOGRAM_H_LEN_SUB / 2)) - 1;
+
+  return static_cast<unsigned long long>(index - shift * (CB_COMMON_HISTOGRAM_H_LEN_SUB / 2)) << shift;
+}
+
+unsigned long long Histogram::highest(std::size_t index) {
+  if (index + 1 >= CB_COMMON_HISTOGRAM_H_LEN_BUCKETS) {
+    return std::numeric_limits<unsigned long long>::max();
+  }
+
+  return lowest(index + 1) - 1;
+}
+
+Histogram::tagShard& Histogram::shard(void) {
+  return *m_shards[shardId() % m_shards.size()];
+}
+
+void Histogram::record(unsigned long long value, unsigned long long n) {
+  tagShard& s = shard();
+
+  s.buckets[index(value)].fetch_add(n, std::memory_order_relaxed);
+  s.count.fetch_add(n, std::memory_order_relaxed);
+  s.sum.fetch_add(value * n, std::memory_order_relaxed);
+  storeMin(s.min, value);
+  storeMax(s.max, value);
+}
+
+void Histogram::merge(const Histogram& rhs) {
+  std::vector<unsigned long long> rtn;
+  tagShard& s = shard();
+
+  rhs.counts(rtn);
+  for (std::size_t i = 0; i < CB_COMMON_HISTOGRAM_H_LEN_BUCKETS; ++i) {
+    if (rtn[i] > 0) {
+      s.buckets[i].fetch_add(rtn[i], std::memory_order_relaxed);
+    }
+  }
+  for (auto it = rhs.m_shards.begin(); it != rhs.m_shards.end(); ++it) {
+    s.count.fetch_add((*it)->count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    s.sum.fetch_add((*it)->sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    storeMin(s.min, (*it)->min.load(std::memory_order_relaxed));
+    storeMax(s.max, (*it)->max.load(std::memory_order_relaxed));
+  }
+}
+
+void Histogram::reset(void) {
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    for (std::size_t i = 0; i < CB_COMMON_HISTOGRAM_H_LEN_BUCKETS; ++i) {
+      (*it)->buckets[i].store(0, std::memory_order_relaxed);
+    }
+    (*it)->count.store(0, std::memory_order_relaxed);
+    (*it)->sum.store(0, std::memory_order_relaxed);
+    (*it)->min.store(std::numeric_limits<unsigned long long>::max(), std::memory_order_relaxed);
+    (*it)->max.store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::counts(std::vector<unsigned long long>& rtn) const {
+  rtn.assign(CB_COMMON_HISTOGRAM_H_LEN_BUCKETS, 0);
+
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    for (std::size_t i = 0; i < CB_COMMON_HISTOGRAM_H_LEN_BUCKETS; ++i) {
+      rtn[i] += (*it)->buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+unsigned long long Histogram::count(void) const {
+  unsigned long long rtn = 0;
+
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    rtn += (*it)->count.load(std::memory_order_relaxed);
+  }
+
+  return rtn;
+}
+
+unsigned long long Histogram::min(void) const {
+  unsigned long long rtn = std::numeric_limits<unsigned long long>::max();
+
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    rtn = std::min(rtn, (*it)->min.load(std::memory_order_relaxed));
+  }
+
+  return (count() == 0) ? 0 : rtn;
+}
+
+unsigned long long Histogram::max(void) const {
+  unsigned long long rtn = 0;
+
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    rtn = std::max(rtn, (*it)->max.load(std::memory_order_relaxed));
+  }
+
+  return rtn;
+}
+
+double Histogram::mean(void) const {
+  unsigned long long n = 0, sum = 0;
+
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    n += (*it)->count.load(std::memory_order_relaxed);
+    sum += (*it)->sum.load(std::memory_order_relaxed);
+  }
+
+  return (n == 0) ? 0.0 : static_cast<double>(sum) / n;
+}
+
+unsigned long long Histogram::percentile(double p) const {
+  std::vector<unsigned long long> buckets;
+  unsigned long long total = 0, target, seen = 0;
+
+  counts(buckets);
+  for (std::size_t i = 0; i < CB_COMMON_HISTOGRAM_H_LEN_BUCKETS; ++i) {
+    total += buckets[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  p = std::min(std::max(p, 0.0), 100.0);
+  target = std::max<unsigned long long>(static_cast<unsigned long long>(p / 100.0 * total + 0.5), 1);
+
+  for (std::size_t i = 0; i < CB_COMMON_HISTOGRAM_H_LEN_BUCKETS; ++i) {
+    seen += buckets[i];
+    if (seen >= target) {
+      // never report past the largest value actually recorded
+      return std::min(highest(i), max());
+    }
+  }
+
+  return max();
+}
+
+std::string Histogram::summary(unsigned long long scale) const {
+  char rtn[256];
+
+  scale = std::max<unsigned long long>(scale, 1);
+  snprintf(rtn, sizeof(rtn), "count=%llu min=%llu p50=%llu p90=%llu p99=%llu p999=%llu max=%llu",
+    count(), min() / scale, percentile(50) / scale, percentile(90) / scale, percentile(99) / scale, percentile(99.9) / scale, max() / scale);
+
+  return std::string(rtn);
+}
+
+} // namespace common
+} // namespace cb
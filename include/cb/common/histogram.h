@@ -0,0 +1,67 @@
+#ifndef CB_COMMON_HISTOGRAM_H_
+#define CB_COMMON_HISTOGRAM_H_
+
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+// 2^SUB_BITS linear sub-buckets per power of two: values are kept within 1 / 2^(SUB_BITS - 1) (~3%)
+#define CB_COMMON_HISTOGRAM_H_SUB_BITS 5
+#define CB_COMMON_HISTOGRAM_H_LEN_SUB (1 << CB_COMMON_HISTOGRAM_H_SUB_BITS)
+#define CB_COMMON_HISTOGRAM_H_LEN_BUCKETS ((64 - CB_COMMON_HISTOGRAM_H_SUB_BITS + 2) * (CB_COMMON_HISTOGRAM_H_LEN_SUB / 2))
+#define CB_COMMON_HISTOGRAM_H_LEN_SHARDS 16
+
+namespace cb {
+namespace common {
+
+// log-linear histogram (HdrHistogram layout) of unsigned values, e.g. latencies in nsec.
+// record() is lock-free: each thread counts into its own shard, queries add the shards up.
+class Histogram {
+ public:
+  // shards: 0 picks one per hardware thread (at most CB_COMMON_HISTOGRAM_H_LEN_SHARDS)
+  explicit Histogram(unsigned int shards = 0);
+  ~Histogram(void);
+  Histogram(const Histogram& rhs) = delete;
+  Histogram& operator =(const Histogram& rhs) = delete;
+
+  void record(unsigned long long value, unsigned long long n = 1);
+  // adds rhs' counts, e.g. to aggregate several histograms for a report
+  void merge(const Histogram& rhs);
+  void reset(void);
+
+  unsigned long long count(void) const;
+  unsigned long long min(void) const;
+  unsigned long long max(void) const;
+  double mean(void) const;
+  // value at or below which p (0 ~ 100) percent of the recorded values fall
+  unsigned long long percentile(double p) const;
+  // "count=.. min=.. p50=.. p90=.. p99=.. p999=.. max=.." in value / scale
+  std::string summary(unsigned long long scale = 1) const;
+
+  static std::size_t index(unsigned long long value);
+  // smallest / largest value counted in the bucket
+  static unsigned long long lowest(std::size_t index);
+  static unsigned long long highest(std::size_t index);
+
+ private:
+  typedef struct {
+    std::atomic<unsigned long long> buckets[CB_COMMON_HISTOGRAM_H_LEN_BUCKETS];
+    std::atomic<unsigned long long> count;
+    std::atomic<unsigned long long> sum;
+    std::atomic<unsigned long long> min;
+    std::atomic<unsigned long long> max;
+  } tagShard;
+
+  tagShard& shard(void);
+  void counts(std::vector<unsigned long long>& rtn) const;
+
+ private:
+  std::vector<std::unique_ptr<tagShard>> m_shards;
+};
+
+} // namespace common
+} // namespace cb
+
+#endif
@@ -0,0 +1,208 @@
+#ifndef CB_COMMON_LOG_FORMAT_HPP_
+#define CB_COMMON_LOG_FORMAT_HPP_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#if __cplusplus >= 201703L
+# include <string_view>
+#endif
+
+// the first argument of a macro's __VA_ARGS__ (EXPAND: MSVC passes __VA_ARGS__ on as one token)
+#define CB_COMMON_LOG_FORMAT_HPP_EXPAND(x) x
+#define CB_COMMON_LOG_FORMAT_HPP_FIRST(format, ...) format
+// (format, args...): format must be a string literal with one {} per argument
+#define CB_COMMON_LOG_FORMAT_HPP_CHECK(...) \
+  static_assert(::cb::common::logfmt::placeholders(CB_COMMON_LOG_FORMAT_HPP_EXPAND(CB_COMMON_LOG_FORMAT_HPP_FIRST(__VA_ARGS__, 0))) == \
+                sizeof(::cb::common::logfmt::arity(__VA_ARGS__)) - 2, \
+                "log format: the number of {} doesn't match the arguments (or a brace isn't escaped as {{ / }})")
+
+namespace cb {
+namespace common {
+
+// "{}" formatting for Logger::print
+//
+// every {} takes the next argument, {{ and }} are literal braces.
+// arguments are appended through FormatArg<T>, which is left undefined for unsupported types
+// so that they fail to compile. specialize it to log your own types:
+//
+//   template <> struct FormatArg<Point> {
+//     static void append(std::string& buf, const Point& v) { ... }
+//   };
+namespace logfmt {
+
+static const std::size_t npos = static_cast<std::size_t>(-1);
+
+// number of {} in format, npos if a brace isn't paired
+constexpr std::size_t placeholders(const char* format, std::size_t n = 0) {
+  return (format[0] == '\0') ? n :
+         (format[0] == '{' && format[1] == '}') ? placeholders(format + 2, n + 1) :
+         (format[0] == '{' && format[1] == '{') ? placeholders(format + 2, n) :
+         (format[0] == '}' && format[1] == '}') ? placeholders(format + 2, n) :
+         (format[0] == '{' || format[0] == '}') ? npos :
+         placeholders(format + 1, n);
+}
+
+// sizeof(arity(args...)) == sizeof...(args) + 1, never evaluated
+template <typename... Args>
+char (&arity(const Args&... args))[sizeof...(Args) + 1];
+
+template <typename T, typename Enable = void>
+struct FormatArg;
+
+template <typename T>
+inline void appendInteger(std::string& buf, T v) {
+  char digits[24];
+  char* p = &digits[sizeof(digits)];
+  bool negative = (v < 0);
+  // negate as unsigned, -INT_MIN overflows
+  unsigned long long u = (negative == true) ? (0ULL - static_cast<unsigned long long>(v)) : static_cast<unsigned long long>(v);
+
+  do {
+    *--p = static_cast<char>('0' + u % 10);
+    u /= 10;
+  } while (u > 0);
+  if (negative == true) {
+    *--p = '-';
+  }
+  buf.append(p, &digits[sizeof(digits)] - p);
+}
+
+template <typename T>
+struct FormatArg<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type> {
+  static void append(std::string& buf, T v) {
+    appendInteger(buf, v);
+  }
+};
+
+template <typename T>
+struct FormatArg<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static void append(std::string& buf, T v) {
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%g", static_cast<double>(v));
+    if (len > 0) {
+      buf.append(tmp, static_cast<std::size_t>(len) < sizeof(tmp) ? len : sizeof(tmp) - 1);
+    }
+  }
+};
+
+template <typename T>
+struct FormatArg<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  static void append(std::string& buf, T v) {
+    appendInteger(buf, static_cast<typename std::underlying_type<T>::type>(v));
+  }
+};
+
+template <>
+struct FormatArg<bool> {
+  static void append(std::string& buf, bool v) {
+    buf.append((v == true) ? "true" : "false");
+  }
+};
+
+template <>
+struct FormatArg<char> {
+  static void append(std::string& buf, char v) {
+    buf.push_back(v);
+  }
+};
+
+template <>
+struct FormatArg<const char*> {
+  static void append(std::string& buf, const char* v) {
+    buf.append((v != NULL) ? v : "(null)");
+  }
+};
+
+template <>
+struct FormatArg<char*> : FormatArg<const char*> {};
+
+// string literals, and char buffers which may not be terminated
+template <std::size_t N>
+struct FormatArg<char[N]> {
+  static void append(std::string& buf, const char (&v)[N]) {
+    const void* end = memchr(v, '\0', N);
+    buf.append(v, (end != NULL) ? static_cast<const char*>(end) - v : N);
+  }
+};
+
+template <>
+struct FormatArg<std::string> {
+  static void append(std::string& buf, const std::string& v) {
+    buf.append(v);
+  }
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct FormatArg<std::string_view> {
+  static void append(std::string& buf, std::string_view v) {
+    buf.append(v.data(), v.size());
+  }
+};
+#endif
+
+// other pointers as addresses
+template <typename T>
+struct FormatArg<T*> {
+  static void append(std::string& buf, const T* v) {
+    char tmp[24];
+    int len = snprintf(tmp, sizeof(tmp), "%p", static_cast<const void*>(v));
+    if (len > 0) {
+      buf.append(tmp, static_cast<std::size_t>(len) < sizeof(tmp) ? len : sizeof(tmp) - 1);
+    }
+  }
+};
+
+// copies format up to the next {} (unescaping {{ and }}), false at the end of it
+inline bool next(std::string& buf, const char*& format) {
+  const char* p = format;
+  const char* q;
+
+  for (;;) {
+    for (q = p; *q != '\0' && *q != '{' && *q != '}'; ++q) {
+    }
+    buf.append(p, q - p);
+
+    if (*q == '\0') {
+      format = q;
+      return false;
+    }
+    if (q[0] == '{' && q[1] == '}') {
+      format = q + 2;
+      return true;
+    }
+    buf.push_back(*q);
+    // {{, }} or a stray brace kept as it is
+    p = (q[1] == q[0]) ? q + 2 : q + 1;
+  }
+}
+
+template <typename T>
+inline void formatArg(std::string& buf, const char*& format, const T& v) {
+  if (next(buf, format) == true) {
+    FormatArg<T>::append(buf, v);
+  }
+}
+
+// appends format to buf. left over {} stay as they are, extra arguments are ignored
+// (Logger's macros reject both at compile time)
+template <typename... Args>
+inline void format(std::string& buf, const char* format, const Args&... args) {
+  // braced initializers are evaluated in order
+  int expand[] = { 0, (formatArg(buf, format, args), 0)... };
+  (void)expand;
+
+  while (next(buf, format) == true) {
+    buf.append("{}");
+  }
+}
+
+} // namespace logfmt
+
+} // namespace common
+} // namespace cb
+
+#endif
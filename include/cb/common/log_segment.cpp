@@ -0,0 +1,155 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstring>
+
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(__CYGWIN__)
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# define CB_COMMON_LOG_SEGMENT_MMAP
+#endif
+
+#include "include/cb/common/log_segment.h"
+
+namespace cb {
+namespace common {
+
+LogSegment::LogSegment(void) :
+  m_fd(-1),
+  m_base(NULL),
+  m_start(0),
+  m_capacity(0),
+  m_key(0),
+  m_offset(0),
+  m_end(0),
+  m_refs(0)
+{
+  m_filename[0] = '\0';
+}
+
+LogSegment::~LogSegment(void) {
+  close();
+}
+
+bool LogSegment::open(const char* filename, std::size_t capacity, unsigned long long key) {
+#if defined(CB_COMMON_LOG_SEGMENT_MMAP)
+  struct stat sb;
+
+  close();
+
+  m_fd = ::open(filename, O_RDWR | O_CREAT, 0644);
+  if (m_fd < 0) {
+    return false;
+  }
+
+  // keep what an earlier process appended to the same file
+  if (fstat(m_fd, &sb) != 0) {
+    close();
+    return false;
+  }
+  m_start = static_cast<std::size_t>(sb.st_size);
+  m_capacity = m_start + capacity;
+
+  if (posix_fallocate(m_fd, 0, m_capacity) != 0) {
+    close();
+    return false;
+  }
+
+  void* base = mmap(NULL, m_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (base == MAP_FAILED) {
+    close();
+    return false;
+  }
+  m_base = static_cast<char*>(base);
+  m_key = key;
+  m_offset.store(m_start);
+  m_end.store(m_start);
+  strncpy(m_filename, filename, sizeof(m_filename) - 1);
+  m_filename[sizeof(m_filename) - 1] = '\0';
+
+  return true;
+#else
+  (void)filename;
+  (void)capacity;
+  (void)key;
+
+  return false;
+#endif
+}
+
+bool LogSegment::append(const char* data, std::size_t len) {
+  std::size_t offset = m_offset.fetch_add(len, std::memory_order_relaxed);
+
+  // reservations are handed out in order, so once one fails every later one fails too
+  if (offset + len > m_capacity) {
+    return false;
+  }
+  memcpy(m_base + offset, data, len);
+
+  std::size_t end = m_end.load(std::memory_order_relaxed);
+  while (end < offset + len && m_end.compare_exchange_weak(end, offset + len, std::memory_order_relaxed) == false) {
+  }
+
+  return true;
+}
+
+void LogSegment::close(void) {
+#if defined(CB_COMMON_LOG_SEGMENT_MMAP)
+  if (m_base != NULL) {
+    munmap(m_base, m_capacity);
+    m_base = NULL;
+  }
+  if (m_fd >= 0) {
+    struct stat sb;
+    struct stat sn;
+    // another segment opened the same file after this one when it grew past our mapping,
+    // the tail is that one's to truncate
+    bool owned = (fstat(m_fd, &sb) == 0 && static_cast<std::size_t>(sb.st_size) == m_capacity);
+
+    if (owned == true && ftruncate(m_fd, m_end.load()) != 0) {
+      // leaves the preallocated zeros, readers stop at the first '\0'
+    }
+    // a spare that created its file and was never used, unless the name was reused meanwhile
+    if (owned == true && m_start == 0 && m_end.load() == 0 &&
+      stat(m_filename, &sn) == 0 && sn.st_dev == sb.st_dev && sn.st_ino == sb.st_ino) {
+      unlink(m_filename);
+    }
+    ::close(m_fd);
+    m_fd = -1;
+  }
+#endif
+  m_start = 0;
+  m_capacity = 0;
+  m_key = 0;
+  m_offset.store(0);
+  m_end.store(0);
+  m_filename[0] = '\0';
+}
+
+bool LogSegment::isOpen(void) const {
+  return m_base != NULL;
+}
+
+unsigned long long LogSegment::key(void) const {
+  return m_key;
+}
+
+const char* LogSegment::filename(void) const {
+  return m_filename;
+}
+
+void LogSegment::ref(void) {
+  m_refs.fetch_add(1);
+}
+
+void LogSegment::unref(void) {
+  m_refs.fetch_sub(1);
+}
+
+unsigned int LogSegment::refs(void) const {
+  return m_refs.load();
+}
+
+} // namespace common
+} // namespace cb
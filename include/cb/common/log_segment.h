@@ -0,0 +1,48 @@
+#ifndef CB_COMMON_LOG_SEGMENT_H_
+#define CB_COMMON_LOG_SEGMENT_H_
+
+#include <cstddef>
+#include <atomic>
+
+namespace cb {
+namespace common {
+
+// preallocated, memory-mapped append-only file.
+// append() reserves its range with a single atomic add and never blocks,
+// close() truncates the file back to the bytes actually written.
+class LogSegment {
+ public:
+  LogSegment(void);
+  ~LogSegment(void);
+  LogSegment(const LogSegment& rhs) = delete;
+  LogSegment& operator =(const LogSegment& rhs) = delete;
+
+  bool open(const char* filename, std::size_t capacity, unsigned long long key);
+  bool append(const char* data, std::size_t len); // false when the segment is full
+  void close(void);
+
+  bool isOpen(void) const;
+  unsigned long long key(void) const;
+  const char* filename(void) const;
+
+  // writers currently inside append(), the owner waits for zero before close()
+  void ref(void);
+  void unref(void);
+  unsigned int refs(void) const;
+
+ private:
+  int m_fd;
+  char* m_base;
+  std::size_t m_start;    // file size before this segment was opened
+  std::size_t m_capacity; // mapped length
+  unsigned long long m_key;
+  char m_filename[256];
+  std::atomic<std::size_t> m_offset;
+  std::atomic<std::size_t> m_end;
+  std::atomic<unsigned int> m_refs;
+};
+
+} // namespace common
+} // namespace cb
+
+#endif
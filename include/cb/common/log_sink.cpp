@@ -0,0 +1,660 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <chrono>
+
+#if !defined(_WIN32) && !defined(_WIN64) && !defined(__CYGWIN__)
+# include <unistd.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# define CB_COMMON_LOG_SINK_SYSLOG
+#endif
+
+#include "include/cb/common/defines.h"
+#include "include/cb/common/times.h"
+#include "include/cb/common/logger.h"
+#include "include/cb/common/log_sink.h"
+
+namespace cb {
+namespace common {
+
+// ---------------------------------------------------- LogSink
+LogSink::LogSink(const char* name, Logger::eLevel level) :
+  m_level(static_cast<unsigned short>(level)),
+  m_batch(CB_COMMON_LOGGER_H_LEN_BATCH),
+  m_interval(0),
+  m_async(false),
+  m_inflight(0),
+  m_dropped(0),
+  m_overflow(Logger::eOverflow::eBlock)
+{
+  strncpy(m_name, name, CB_COMMON_LOG_SINK_H_LEN_NAME - 1);
+  m_name[CB_COMMON_LOG_SINK_H_LEN_NAME - 1] = '\0';
+}
+
+LogSink::~LogSink(void) {
+  stop();
+}
+
+const char* LogSink::name(void) const {
+  return m_name;
+}
+
+Logger::eLevel LogSink::setLevel(Logger::eLevel level) {
+  m_level.store(static_cast<unsigned short>(level));
+
+  return level;
+}
+
+bool LogSink::enabled(Logger::eLevel level) const {
+  return static_cast<unsigned short>(level) <= m_level.load(std::memory_order_relaxed);
+}
+
+void LogSink::setBatch(unsigned int batch, unsigned int interval) {
+  std::lock_guard<std::mutex> guard(m_async_mtx);
+
+  m_batch = std::max<unsigned int>(batch, 1);
+  m_interval = interval;
+}
+
+bool LogSink::isAsync(void) const {
+  return m_async.load();
+}
+
+unsigned long long LogSink::dropped(void) const {
+  return m_dropped.load();
+}
+
+void LogSink::flush(void) {
+}
+
+bool LogSink::concurrent(void) const {
+  return false;
+}
+
+void LogSink::writeRecord(const Logger::tagRecord& rec) {
+  char timeinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
+  char line[CB_COMMON_LOG_SINK_H_LEN_LINE] = { '\0' };
+  int len;
+
+  times::iso8601(timeinfo, rec.utmilli);
+  len = snprintf(line, sizeof(line), "[%s][%s] %s\n", timeinfo, Logger::LEVELS[static_cast<int>(rec.level)], rec.contents);
+  len = std::min<int>(len, sizeof(line) - 1);
+
+  write(rec, line, len);
+}
+
+void LogSink::submit(const Logger::tagRecord& rec) {
+  if (enabled(rec.level) == false) {
+    return;
+  }
+
+  m_inflight.fetch_add(1);
+  if (m_async.load() == true) {
+    enqueue(rec);
+    m_inflight.fetch_sub(1);
+    return;
+  }
+  m_inflight.fetch_sub(1);
+
+  if (concurrent() == true) {
+    writeRecord(rec);
+    flush();
+  } else {
+    std::lock_guard<std::mutex> guard(m_mtx);
+    writeRecord(rec);
+    flush();
+  }
+}
+
+void LogSink::enqueue(const Logger::tagRecord& rec) {
+  if (m_queue->push(rec) == false) {
+    Logger::tagRecord discard;
+
+    switch (m_overflow) {
+    case Logger::eOverflow::eDropNewest:
+      m_dropped.fetch_add(1);
+      break;
+    case Logger::eOverflow::eDropOldest:
+      while (m_queue->push(rec) == false) {
+        if (m_queue->pop(discard) == true) {
+          m_dropped.fetch_add(1);
+        }
+      }
+      break;
+    case Logger::eOverflow::eBlock:
+    default:
+      m_queue->pushWait(rec);
+      break;
+    }
+  }
+}
+
+void LogSink::drain(void) {
+  std::unique_ptr<Logger::tagRecord> rec(new Logger::tagRecord);
+  std::chrono::steady_clock::time_point flushed = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point now = flushed;
+  std::chrono::milliseconds interval(m_interval);
+  bool dirty = false;
+
+  m_queue->consume([&](bool stop) -> unsigned int {
+    unsigned int n;
+
+    for (n = 0; n < m_batch && m_queue->pop(*rec) == true; ++n) {
+      writeRecord(*rec);
+    }
+    if (n > 0) {
+      dirty = true;
+    }
+
+    // group commit: one flush per batch, or per interval
+    now = std::chrono::steady_clock::now();
+    if (dirty == true && (m_interval == 0 || now - flushed >= interval || (stop == true && n == 0))) {
+      flush();
+      dirty = false;
+      flushed = now;
+    }
+
+    return n;
+  }, [&]() {
+    std::chrono::milliseconds wait(CB_COMMON_LOG_SINK_H_INTERVAL);
+
+    if (dirty == true) {
+      wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(interval - (now - flushed)));
+    }
+
+    return wait;
+  });
+}
+
+bool LogSink::start(unsigned int capacity, Logger::eOverflow overflow) {
+  stop();
+
+  std::lock_guard<std::mutex> guard(m_async_mtx);
+
+  m_overflow = overflow;
+  m_queue.reset(new BatchQueue<Logger::tagRecord>(capacity));
+  m_writer.reset(new std::thread([this]() {
+    drain();
+  }));
+  m_async.store(true);
+
+  return true;
+}
+
+void LogSink::stop(void) {
+  std::lock_guard<std::mutex> guard(m_async_mtx);
+
+  if (m_writer.get() == nullptr) {
+    return;
+  }
+
+  // no new producers, then wait for the ones already pushing
+  m_async.store(false);
+  while (m_inflight.load() > 0) {
+    std::this_thread::yield();
+  }
+
+  m_queue->stop();
+  m_writer->join();
+  m_writer.reset();
+  m_queue.reset();
+}
+
+// ---------------------------------------------------- LogSinkFile
+LogSinkFile::LogSinkFile(const char* path, unsigned int split, std::size_t segment, Logger::eLevel level) :
+  LogSink("file", level),
+  m_split(split),
+  m_key(0),
+  m_fp(NULL),
+  m_segment(NULL),
+  m_spare(NULL),
+  m_segment_size(segment),
+  m_segment_seq(0),
+  m_prep_stop(false),
+  m_prep_key(0)
+{
+  strncpy(m_path, path, CB_COMMON_LOGGER_H_LEN_PATH - 1);
+  m_path[CB_COMMON_LOGGER_H_LEN_PATH - 1] = '\0';
+  m_prep_filename[0] = '\0';
+}
+
+LogSinkFile::~LogSinkFile(void) {
+  stop();
+  closeSegments();
+  for (auto it = m_segments_free.begin(); it != m_segments_free.end(); ++it) {
+    delete *it;
+  }
+  m_segments_free.clear();
+
+  if (m_fp != NULL) {
+    fclose(m_fp);
+    m_fp = NULL;
+  }
+}
+
+void LogSinkFile::setPath(const char* path) {
+  closeSegments();
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+  strncpy(m_path, path, CB_COMMON_LOGGER_H_LEN_PATH - 1);
+  m_path[CB_COMMON_LOGGER_H_LEN_PATH - 1] = '\0';
+  if (m_fp != NULL) {
+    fclose(m_fp);
+    m_fp = NULL;
+  }
+}
+
+void LogSinkFile::setSplit(unsigned int split) {
+  closeSegments();
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+  m_split = split;
+}
+
+void LogSinkFile::setSegment(std::size_t capacity) {
+  closeSegments();
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+  m_segment_size.store(capacity);
+}
+
+unsigned long long LogSinkFile::periodKey(const struct tm* ptm, unsigned int split) {
+  unsigned long long rtn = ptm->tm_year;
+
+  rtn = rtn * 100 + ptm->tm_mon;
+  rtn = rtn * 100 + ptm->tm_mday;
+  rtn = rtn * 100 + ptm->tm_hour;
+  rtn = rtn * 100 + ptm->tm_min / split % split;
+
+  // 0 means "no segment"
+  return rtn + 1;
+}
+
+void LogSinkFile::periodName(char* filename, const char* path, unsigned int split, const struct tm* ptm, unsigned int seq, const char* ext) {
+  char currinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
+
+  strftime(currinfo, CB_DEFINES_H_LEN_ISO8601, "%Y-%m-%d-%H", ptm);
+  sprintf(&currinfo[strlen(currinfo)], "-%02d", ptm->tm_min / split % split);
+
+  strcpy(filename, path);
+  sprintf(&filename[strlen(filename)], "%cserver.%s", PATH_SEP, currinfo);
+  if (seq > 0) {
+    sprintf(&filename[strlen(filename)], ".%u", seq);
+  }
+  strcat(filename, ext);
+}
+
+bool LogSinkFile::concurrent(void) const {
+  return true;
+}
+
+void LogSinkFile::write(const Logger::tagRecord& rec, const char* line, std::size_t len) {
+  char timeinfo[CB_DEFINES_H_LEN_ISO8601];
+  struct tm* ptm;
+
+  if (m_path[0] == '\0') {
+    return;
+  }
+
+  // broken down once per second per thread (the line was just rendered from the same one)
+  ptm = times::iso8601(timeinfo, rec.utmilli);
+
+  if (m_segment_size.load() > 0 && appendSegment(periodKey(ptm, m_split), ptm, rec.utmilli, line, len) == true) {
+    return;
+  }
+
+  writeFile(ptm, line, len);
+}
+
+void LogSinkFile::flush(void) {
+  if (m_segment_size.load() > 0) {
+    // nothing buffered in user space
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+
+  if (m_fp != NULL) {
+    fflush(m_fp);
+  }
+}
+
+bool LogSinkFile::appendSegment(unsigned long long key, const struct tm* ptm, unsigned long long utmilli, const char* line, std::size_t len) {
+  LogSegment* seg;
+
+  // one retry per rotation, a line bigger than a whole segment goes to the fallback
+  for (int attempt = 0; attempt < 3; ++attempt) {
+    seg = m_segment.load();
+    if (seg != NULL) {
+      seg->ref();
+      if (seg == m_segment.load() && seg->key() == key && seg->append(line, len) == true) {
+        seg->unref();
+        return true;
+      }
+      seg->unref();
+    }
+
+    if (rotateSegment(seg, key, ptm, utmilli) == false) {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+bool LogSinkFile::rotateSegment(LogSegment* seen, unsigned long long key, const struct tm* ptm, unsigned long long utmilli) {
+  char filename[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
+  LogSegment* next = NULL;
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+
+  if (m_segment_size == 0) {
+    return false;
+  }
+  if (m_segment.load() != seen) {
+    // rotated by another thread meanwhile
+    return true;
+  }
+  if (seen != NULL && seen->key() > key) {
+    // a record from the previous period arriving late, not worth reopening for
+    return false;
+  }
+
+  m_segment_seq = (seen != NULL && seen->key() == key) ? m_segment_seq + 1 : 0;
+
+  if (m_segment_seq == 0 && m_spare != NULL && m_spare->key() == key) {
+    next = m_spare;
+    m_spare = NULL;
+  } else {
+    periodName(filename, m_path, m_split, ptm, m_segment_seq, ".log");
+    next = allocSegment();
+    if (next->open(filename, m_segment_size, key) == false) {
+      m_segments_free.push_back(next);
+      // mapping unavailable, stay on fopen/fprintf from now on
+      m_segment_size.store(0);
+      return false;
+    }
+  }
+
+  m_segment.store(next);
+
+  if (seen != NULL) {
+    retireSegment(seen);
+  }
+
+  // open the next period's segment off the logging path
+  time_t rawtime = static_cast<time_t>(utmilli / 1000000 + m_split * 60);
+  struct tm tm_next;
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+  gmtime_s(&tm_next, &rawtime);
+#else
+  gmtime_r(&rawtime, &tm_next);
+#endif
+  unsigned long long key_next = periodKey(&tm_next, m_split);
+  if (key_next == key || (m_spare != NULL && m_spare->key() == key_next)) {
+    // still this period's file, or already there after a rotation by size
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_prep_mtx);
+    m_prep_key = key_next;
+    periodName(m_prep_filename, m_path, m_split, &tm_next, 0, ".log");
+    if (m_preparer.get() == nullptr) {
+      m_preparer.reset(new std::thread([this]() {
+        prepareSegment();
+      }));
+    }
+  }
+  m_cv_prep.notify_one();
+
+  return true;
+}
+
+void LogSinkFile::prepareSegment(void) {
+  char filename[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
+  unsigned long long key;
+  std::unique_lock<std::mutex> lock(m_prep_mtx);
+
+  for (;;) {
+    m_cv_prep.wait(lock, [this]() {
+      return m_prep_stop == true || m_prep_key != 0;
+    });
+    if (m_prep_stop == true) {
+      break;
+    }
+    key = m_prep_key;
+    strcpy(filename, m_prep_filename);
+    m_prep_key = 0;
+    lock.unlock();
+
+    LogSegment* seg;
+    {
+      std::lock_guard<std::mutex> guard(m_mtx);
+      LogSegment* current = m_segment.load();
+      if ((m_spare != NULL && m_spare->key() == key) || (current != NULL && current->key() >= key)) {
+        // asked twice for the same period or reached already, opening the file again would map it twice
+        lock.lock();
+        continue;
+      }
+      seg = allocSegment();
+    }
+    // the slow part (fallocate) runs without m_mtx
+    bool opened = seg->open(filename, m_segment_size, key);
+    {
+      std::lock_guard<std::mutex> guard(m_mtx);
+      if (m_spare != NULL) {
+        retireSegment(m_spare);
+        m_spare = NULL;
+      }
+      if (opened == true) {
+        m_spare = seg;
+      } else {
+        m_segments_free.push_back(seg);
+      }
+    }
+
+    lock.lock();
+  }
+}
+
+LogSegment* LogSinkFile::allocSegment(void) {
+  LogSegment* rtn;
+
+  if (m_segments_free.empty() == true) {
+    rtn = new LogSegment();
+  } else {
+    rtn = m_segments_free.back();
+    m_segments_free.pop_back();
+  }
+
+  return rtn;
+}
+
+void LogSinkFile::retireSegment(LogSegment* seg) {
+  while (seg->refs() > 0) {
+    std::this_thread::yield();
+  }
+  seg->close();
+  m_segments_free.push_back(seg);
+}
+
+void LogSinkFile::closeSegments(void) {
+  {
+    std::lock_guard<std::mutex> lock(m_prep_mtx);
+    m_prep_stop = true;
+  }
+  m_cv_prep.notify_one();
+  if (m_preparer.get() != nullptr) {
+    m_preparer->join();
+    m_preparer.reset();
+  }
+  m_prep_stop = false;
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+  LogSegment* seg = m_segment.exchange(NULL);
+  if (seg != NULL) {
+    retireSegment(seg);
+  }
+  if (m_spare != NULL) {
+    retireSegment(m_spare);
+    m_spare = NULL;
+  }
+}
+
+void LogSinkFile::writeFile(const struct tm* ptm, const char* line, std::size_t len) {
+  char filename[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
+  unsigned long long key = periodKey(ptm, m_split);
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+
+  if (m_fp == NULL || m_key != key) {
+    if (m_fp != NULL) {
+      fclose(m_fp);
+    }
+    periodName(filename, m_path, m_split, ptm, 0, ".log");
+    m_fp = fopen(filename, "a");
+    m_key = key;
+  }
+
+  if (m_fp != NULL) {
+    fwrite(line, 1, len, m_fp);
+  }
+
+  // closed in destructor
+}
+
+// ---------------------------------------------------- LogSinkConsole
+LogSinkConsole::LogSinkConsole(FILE* fp, Logger::eLevel level) :
+  LogSink((fp == stderr) ? "stderr" : "console", level),
+  m_fp(fp)
+{}
+
+LogSinkConsole::~LogSinkConsole(void) {
+  stop();
+}
+
+void LogSinkConsole::write(const Logger::tagRecord& /*rec*/, const char* line, std::size_t len) {
+  fwrite(line, 1, len, m_fp);
+}
+
+void LogSinkConsole::flush(void) {
+  fflush(m_fp);
+}
+
+// ---------------------------------------------------- LogSinkMemory
+LogSinkMemory::LogSinkMemory(std::size_t lines, Logger::eLevel level) :
+  LogSink("memory", level),
+  m_capacity(std::max<std::size_t>(lines, 1))
+{}
+
+LogSinkMemory::~LogSinkMemory(void) {
+  stop();
+}
+
+void LogSinkMemory::write(const Logger::tagRecord& /*rec*/, const char* line, std::size_t len) {
+  std::lock_guard<std::mutex> guard(m_lines_mtx);
+
+  if (m_lines.size() >= m_capacity) {
+    // reuse the oldest line's storage
+    m_lines.push_back(std::move(m_lines.front()));
+    m_lines.pop_front();
+    m_lines.back().assign(line, len);
+  } else {
+    m_lines.push_back(std::string(line, len));
+  }
+}
+
+std::string LogSinkMemory::snapshot(std::size_t n) const {
+  std::string rtn;
+  std::lock_guard<std::mutex> guard(m_lines_mtx);
+
+  std::size_t skip = (n == 0 || n >= m_lines.size()) ? 0 : m_lines.size() - n;
+  for (auto it = m_lines.begin() + skip; it != m_lines.end(); ++it) {
+    rtn += *it;
+  }
+
+  return rtn;
+}
+
+// ---------------------------------------------------- LogSinkSyslog
+LogSinkSyslog::LogSinkSyslog(const char* ident, const char* socket, Logger::eLevel level) :
+  LogSink("syslog", level),
+  m_fd(-1)
+{
+  strncpy(m_ident, ident, CB_COMMON_LOG_SINK_H_LEN_NAME - 1);
+  m_ident[CB_COMMON_LOG_SINK_H_LEN_NAME - 1] = '\0';
+  strncpy(m_socket, socket, CB_COMMON_LOGGER_H_LEN_PATH - 1);
+  m_socket[CB_COMMON_LOGGER_H_LEN_PATH - 1] = '\0';
+  reconnect();
+}
+
+LogSinkSyslog::~LogSinkSyslog(void) {
+  stop();
+#if defined(CB_COMMON_LOG_SINK_SYSLOG)
+  if (m_fd >= 0) {
+    close(m_fd);
+  }
+#endif
+}
+
+void LogSinkSyslog::reconnect(void) {
+#if defined(CB_COMMON_LOG_SINK_SYSLOG)
+  struct sockaddr_un addr;
+  std::size_t len = strlen(m_socket);
+
+  if (m_fd >= 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+  if (len >= sizeof(addr.sun_path)) {
+    // wouldn't fit with its '\0', connecting to a truncated path could reach another socket
+    return;
+  }
+  m_fd = ::socket(AF_UNIX, SOCK_DGRAM, 0);
+  if (m_fd < 0) {
+    return;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  memcpy(addr.sun_path, m_socket, len + 1);
+  if (connect(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0) {
+    close(m_fd);
+    m_fd = -1;
+  }
+#endif
+}
+
+void LogSinkSyslog::write(const Logger::tagRecord& rec, const char* /*line*/, std::size_t /*len*/) {
+#if defined(CB_COMMON_LOG_SINK_SYSLOG)
+  // user facility, severity by level
+  static const int severity[] = { 3, 4, 6, 7 };
+  char msg[CB_COMMON_LOG_SINK_H_LEN_LINE + CB_COMMON_LOG_SINK_H_LEN_NAME] = { '\0' };
+  char stamp[16] = { '\0' };
+  struct tm tm_rec;
+  time_t rawtime = static_cast<time_t>(rec.utmilli / 1000000);
+  int n;
+
+  localtime_r(&rawtime, &tm_rec);
+  strftime(stamp, sizeof(stamp), "%b %e %H:%M:%S", &tm_rec);
+  n = snprintf(msg, sizeof(msg), "<%d>%s %s: %s", 8 + severity[static_cast<int>(rec.level)], stamp, m_ident, rec.contents);
+  n = std::min<int>(n, sizeof(msg) - 1);
+
+  if (m_fd < 0 || send(m_fd, msg, n, 0) < 0) {
+    // syslogd restarted
+    reconnect();
+    if (m_fd >= 0) {
+      send(m_fd, msg, n, 0);
+    }
+  }
+#else
+  (void)rec;
+#endif
+}
+
+} // namespace common
+} // namespace cb
@@ -0,0 +1,188 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef CB_COMMON_LOG_SINK_H_
+#define CB_COMMON_LOG_SINK_H_
+
+#include <cstdio>
+#include <ctime>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "include/cb/common/defines.h"
+#include "include/cb/common/logger.h"
+#include "include/cb/common/batch_queue.hpp"
+#include "include/cb/common/log_segment.h"
+
+#define CB_COMMON_LOG_SINK_H_LEN_NAME 32
+#define CB_COMMON_LOG_SINK_H_LEN_LINE (CB_DEFINES_H_LEN_ISO8601 + CB_COMMON_LOGGER_H_LEN_CONTENTS + 16)
+#define CB_COMMON_LOG_SINK_H_LEN_MEMORY 1024
+#define CB_COMMON_LOG_SINK_H_INTERVAL 10 // msec
+#define CB_COMMON_LOG_SINK_H_SYSLOG "/dev/log"
+
+namespace cb {
+namespace common {
+
+// destination of log records.
+// Logger hands every record to each of its sinks, which filter by their own level.
+// once started, a sink queues records and writes them from its own thread,
+// so that a slow one never holds back the others.
+class LogSink {
+ public:
+  explicit LogSink(const char* name, Logger::eLevel level = Logger::eLevel::eDebug);
+  virtual ~LogSink(void); // derived classes stop() first, the writer thread calls into them
+  LogSink(const LogSink& rhs) = delete;
+  LogSink& operator =(const LogSink& rhs) = delete;
+
+  const char* name(void) const;
+  Logger::eLevel setLevel(Logger::eLevel level);
+  bool enabled(Logger::eLevel level) const;
+  // batch: records written between two flushes at most
+  // interval: msec a written record may stay unflushed (0: flush whenever the queue runs dry)
+  void setBatch(unsigned int batch, unsigned int interval);
+  // queue + writer thread. stop() drains what is queued before returning
+  bool start(unsigned int capacity = CB_COMMON_LOGGER_H_LEN_QUEUE, Logger::eOverflow overflow = Logger::eOverflow::eBlock);
+  void stop(void);
+  bool isAsync(void) const;
+  unsigned long long dropped(void) const;
+
+  void submit(const Logger::tagRecord& rec);
+
+ protected:
+  // line is "[timestamp][LEVEL] contents\n"
+  virtual void write(const Logger::tagRecord& rec, const char* line, std::size_t len) = 0;
+  virtual void flush(void);
+  // true when write() copes with concurrent callers by itself
+  virtual bool concurrent(void) const;
+
+ private:
+  void writeRecord(const Logger::tagRecord& rec);
+  void enqueue(const Logger::tagRecord& rec);
+  void drain(void);
+
+ private:
+  char m_name[CB_COMMON_LOG_SINK_H_LEN_NAME];
+  std::atomic<unsigned short> m_level;
+  std::mutex m_mtx; // write() in sync mode
+  std::mutex m_async_mtx; // start, stop
+  unsigned int m_batch;
+  unsigned int m_interval;
+  std::atomic<bool> m_async;
+  std::atomic<unsigned int> m_inflight;
+  std::atomic<unsigned long long> m_dropped;
+  Logger::eOverflow m_overflow;
+  std::unique_ptr<BatchQueue<Logger::tagRecord>> m_queue;
+  std::unique_ptr<std::thread> m_writer;
+};
+
+// server.YYYY-MM-DD-HH-mm.log under path, one file every split minutes.
+// lines are appended to preallocated mapped segments (LogSegment) without a lock,
+// fopen/fprintf is the fallback when mapping isn't available.
+class LogSinkFile : public LogSink {
+ public:
+  LogSinkFile(const char* path, unsigned int split, std::size_t segment = CB_COMMON_LOGGER_H_LEN_SEGMENT, Logger::eLevel level = Logger::eLevel::eDebug);
+  virtual ~LogSinkFile(void);
+
+  void setPath(const char* path);
+  void setSplit(unsigned int split);
+  // size of the segments, 0 goes back to fopen/fprintf
+  void setSegment(std::size_t capacity);
+
+  static unsigned long long periodKey(const struct tm* ptm, unsigned int split);
+  static void periodName(char* filename, const char* path, unsigned int split, const struct tm* ptm, unsigned int seq, const char* ext);
+
+ protected:
+  virtual void write(const Logger::tagRecord& rec, const char* line, std::size_t len);
+  virtual void flush(void);
+  virtual bool concurrent(void) const;
+
+ private:
+  bool appendSegment(unsigned long long key, const struct tm* ptm, unsigned long long utmilli, const char* line, std::size_t len);
+  bool rotateSegment(LogSegment* seen, unsigned long long key, const struct tm* ptm, unsigned long long utmilli);
+  void prepareSegment(void);
+  LogSegment* allocSegment(void);
+  void retireSegment(LogSegment* seg);
+  void closeSegments(void);
+  void writeFile(const struct tm* ptm, const char* line, std::size_t len);
+
+ private:
+  std::mutex m_mtx;
+  char m_path[CB_COMMON_LOGGER_H_LEN_PATH];
+  unsigned int m_split;
+  unsigned long long m_key; // m_mtx, period of m_fp
+  FILE* m_fp;
+
+  std::atomic<LogSegment*> m_segment;
+  LogSegment* m_spare; // m_mtx, opened ahead for the next period
+  // m_mtx, closed segments. writers may still hold a stale pointer for a moment,
+  // so they are recycled instead of deleted (until the sink goes away)
+  std::vector<LogSegment*> m_segments_free;
+  std::atomic<std::size_t> m_segment_size;
+  unsigned int m_segment_seq; // m_mtx, segments of the current period that filled up
+  std::mutex m_prep_mtx;
+  std::condition_variable m_cv_prep;
+  std::unique_ptr<std::thread> m_preparer;
+  bool m_prep_stop;
+  unsigned long long m_prep_key;
+  char m_prep_filename[CB_COMMON_LOGGER_H_LEN_PATH];
+};
+
+// stdout / stderr
+class LogSinkConsole : public LogSink {
+ public:
+  explicit LogSinkConsole(FILE* fp = stdout, Logger::eLevel level = Logger::eLevel::eDebug);
+  virtual ~LogSinkConsole(void);
+
+ protected:
+  virtual void write(const Logger::tagRecord& rec, const char* line, std::size_t len);
+  virtual void flush(void);
+
+ private:
+  FILE* m_fp;
+};
+
+// the latest lines kept in memory, e.g. for an admin route
+class LogSinkMemory : public LogSink {
+ public:
+  explicit LogSinkMemory(std::size_t lines = CB_COMMON_LOG_SINK_H_LEN_MEMORY, Logger::eLevel level = Logger::eLevel::eDebug);
+  virtual ~LogSinkMemory(void);
+
+  // oldest first, at most the last n lines (0: all of them)
+  std::string snapshot(std::size_t n = 0) const;
+
+ protected:
+  virtual void write(const Logger::tagRecord& rec, const char* line, std::size_t len);
+
+ private:
+  mutable std::mutex m_lines_mtx;
+  std::size_t m_capacity;
+  std::deque<std::string> m_lines;
+};
+
+// RFC 3164 datagrams to the local syslog socket
+class LogSinkSyslog : public LogSink {
+ public:
+  explicit LogSinkSyslog(const char* ident, const char* socket = CB_COMMON_LOG_SINK_H_SYSLOG, Logger::eLevel level = Logger::eLevel::eDebug);
+  virtual ~LogSinkSyslog(void);
+
+ protected:
+  virtual void write(const Logger::tagRecord& rec, const char* line, std::size_t len);
+
+ private:
+  void reconnect(void);
+
+ private:
+  int m_fd;
+  char m_ident[CB_COMMON_LOG_SINK_H_LEN_NAME];
+  char m_socket[CB_COMMON_LOGGER_H_LEN_PATH];
+};
+
+} // namespace common
+} // namespace cb
+
+#endif
@@ -5,10 +5,14 @@
 #include <cstring>
 #include <ctime>
 #include <cstdarg>
+#include <algorithm>
+#include <thread>
 
 #include "include/cb/common/defines.h"
 #include "include/cb/common/times.h"
 #include "include/cb/common/logger.h"
+#include "include/cb/common/logger_binary.h"
+#include "include/cb/common/log_sink.h"
 
 #if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
 # include <direct.h>
@@ -17,61 +21,177 @@
 namespace cb {
 namespace common {
 
-Logger::Logger(void) {
+struct Logger::tagBinaryBuffer {
+  std::mutex mtx;
+  std::string data;
+  unsigned long long utmilli; // oldest record in data
+  std::unordered_map<const char*, unsigned int> ids; // owner thread only
+
+  tagBinaryBuffer(void) : utmilli(0) {
+    data.reserve(CB_COMMON_LOGGER_H_LEN_BINARY);
+    std::lock_guard<std::mutex> guard(m_instance.m_binary_mtx);
+    m_instance.m_binary_buffers.push_back(this);
+  }
+
+  ~tagBinaryBuffer(void) {
+    std::lock_guard<std::mutex> guard(m_instance.m_binary_mtx);
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      m_instance.flushBinary(*this);
+    }
+    for (auto it = m_instance.m_binary_buffers.begin(); it != m_instance.m_binary_buffers.end(); ++it) {
+      if (*it == this) {
+        m_instance.m_binary_buffers.erase(it);
+        break;
+      }
+    }
+  }
+};
+
+Logger::Logger(void) :
+  m_level(static_cast<unsigned short>(eLevel::eDebug)),
+  m_inflight(0),
+  m_truncated(0),
+  m_async(false),
+  m_capacity(CB_COMMON_LOGGER_H_LEN_QUEUE),
+  m_overflow(eOverflow::eBlock),
+  m_binary(false),
+  m_binary_flushed(0),
+  m_binary_fp(NULL),
+  m_binary_key(0),
+  m_binary_queued(0),
+  m_binary_written(0),
+  m_binary_stop(false)
+{
   m_cnt = 0;
   m_split = 10;
-  m_fp = NULL;
-  m_currinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
-  m_path[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
+  m_path[0] = '\0';
+  for (unsigned int i = 0; i < CB_COMMON_LOGGER_H_LEN_SINKS; ++i) {
+    m_sinks[i].store(NULL);
+  }
+
+  // file + stdout mirror, as it has always been
+  m_file = std::make_shared<LogSinkFile>(m_path, m_split);
+  m_console = std::make_shared<LogSinkConsole>(stdout);
+  m_sinks[0].store(m_file.get());
+  m_sinks[1].store(m_console.get());
+  m_sinks_owned.push_back(m_file);
+  m_sinks_owned.push_back(m_console);
   // fopen
 }
 
 Logger::~Logger(void) {
-  if (m_fp != NULL) {
-    m_instance.m_mtx.lock();
-    if (m_fp != NULL) {
-      fclose(m_fp);
-    }
-    m_instance.m_mtx.unlock();
+  // drain on shutdown
+  for (unsigned int i = 0; i < CB_COMMON_LOGGER_H_LEN_SINKS; ++i) {
+    m_sinks[i].store(NULL);
+  }
+  while (m_inflight.load() > 0) {
+    std::this_thread::yield();
+  }
+  for (auto it = m_sinks_owned.begin(); it != m_sinks_owned.end(); ++it) {
+    (*it)->stop();
+  }
+  m_sinks_owned.clear();
+  m_console.reset();
+  m_file.reset();
+
+  stopBinary();
+  if (m_binary_fp != NULL) {
+    fclose(m_binary_fp);
+    m_binary_fp = NULL;
   }
   // printf("m_cnt: %u\n", m_cnt);
 }
 
-void Logger::writeFile(eLevel level, const char* timeinfo, const char* currinfo, const char* filename, const char* filecontents) {
-  if (strlen(m_path) == 0) {
-    return;
+void Logger::route(const tagRecord& rec) {
+  LogSink* sink;
+  unsigned long long started = times::cycles();
+
+  m_inflight.fetch_add(1);
+  for (unsigned int i = 0; i < CB_COMMON_LOGGER_H_LEN_SINKS; ++i) {
+    sink = m_sinks[i].load();
+    if (sink != NULL) {
+      sink->submit(rec);
+    }
   }
+  m_inflight.fetch_sub(1);
+
+  m_latency.record(times::cyclesToNanos(times::cycles() - started));
+}
+
+bool Logger::addSink(std::shared_ptr<LogSink> sink) {
+  std::lock_guard<std::mutex> guard(m_instance.m_mtx);
 
-  if (m_fp == NULL) {
-    m_instance.m_mtx.lock();
-    if (m_fp == NULL) {
-      m_fp = fopen(filename, "a");
-      strcpy(m_instance.m_currinfo, currinfo);
-      //fprintf(m_fp, "[%s][%s] file open\n", timeinfo, LEVELS[static_cast<int>(level)]); // @debug
+  for (unsigned int i = 0; i < CB_COMMON_LOGGER_H_LEN_SINKS; ++i) {
+    if (m_instance.m_sinks[i].load() == NULL) {
+      if (m_instance.m_async == true && sink->isAsync() == false) {
+        sink->start(m_instance.m_capacity, m_instance.m_overflow);
+      }
+      m_instance.m_sinks_owned.push_back(sink);
+      m_instance.m_sinks[i].store(sink.get());
+      return true;
     }
-    m_instance.m_mtx.unlock();
-  } else if (strcmp(m_instance.m_currinfo, currinfo) != 0) {
-    m_instance.m_mtx.lock();
-    if (strcmp(m_instance.m_currinfo, currinfo) != 0) {
-      fclose(m_fp);
-      m_fp = fopen(filename, "a");
-      strcpy(m_instance.m_currinfo, currinfo);
-      //fprintf(m_fp, "[%s][%s] file close, open\n", timeinfo, LEVELS[static_cast<int>(level)]); // @debug
+  }
+
+  return false;
+}
+
+bool Logger::removeSink(const char* name) {
+  std::shared_ptr<LogSink> removed;
+
+  {
+    std::lock_guard<std::mutex> guard(m_instance.m_mtx);
+
+    for (auto it = m_instance.m_sinks_owned.begin(); it != m_instance.m_sinks_owned.end(); ++it) {
+      if (strcmp((*it)->name(), name) == 0) {
+        removed = *it;
+        m_instance.m_sinks_owned.erase(it);
+        break;
+      }
+    }
+    if (removed.get() == nullptr) {
+      return false;
+    }
+    for (unsigned int i = 0; i < CB_COMMON_LOGGER_H_LEN_SINKS; ++i) {
+      if (m_instance.m_sinks[i].load() == removed.get()) {
+        m_instance.m_sinks[i].store(NULL);
+      }
     }
-    m_instance.m_mtx.unlock();
   }
 
-  if (m_fp != NULL) {
-    fprintf(m_fp, "[%s][%s] %s\n", timeinfo, LEVELS[static_cast<int>(level)], filecontents);
-    fflush(m_fp);
-    printf("[%s][%s] %s\n", timeinfo, LEVELS[static_cast<int>(level)], filecontents);
+  // nobody may still be inside submit() once it goes away
+  while (m_instance.m_inflight.load() > 0) {
+    std::this_thread::yield();
+  }
+  removed->stop();
+
+  return true;
+}
+
+std::shared_ptr<LogSink> Logger::sink(const char* name) {
+  std::lock_guard<std::mutex> guard(m_instance.m_mtx);
+
+  for (auto it = m_instance.m_sinks_owned.begin(); it != m_instance.m_sinks_owned.end(); ++it) {
+    if (strcmp((*it)->name(), name) == 0) {
+      return *it;
+    }
   }
 
-  // closed in destructor
+  return std::shared_ptr<LogSink>();
+}
+
+std::size_t Logger::setSegment(std::size_t capacity) {
+  m_instance.m_file->setSegment(capacity);
+
+  return capacity;
 }
 
 unsigned int Logger::setSplit(unsigned int split) {
-  m_instance.m_split = split;
+  {
+    std::lock_guard<std::mutex> guard(m_instance.m_mtx);
+    m_instance.m_split = split;
+  }
+  m_instance.m_file->setSplit(split);
 
   return m_instance.m_split;
 }
@@ -89,6 +209,7 @@ bool Logger::setPath(const char* path)
   //if (strlen(LOGDIR) == 0) {
   memcpy((void*)m_instance.m_path, path_tmp, CB_COMMON_LOGGER_H_LEN_PATH);
   //}
+  m_instance.m_file->setPath(path_tmp);
 
   rtn = stat(path_tmp, &sb);
   if (rtn == false) {
@@ -111,43 +232,392 @@ bool Logger::setPath(const char* path)
   return rtn;
 }
 
+bool Logger::setAsync(bool async, unsigned int capacity, eOverflow overflow) {
+  std::lock_guard<std::mutex> guard(m_instance.m_mtx);
+
+  m_instance.m_async = async;
+  m_instance.m_capacity = capacity;
+  m_instance.m_overflow = overflow;
+
+  for (auto it = m_instance.m_sinks_owned.begin(); it != m_instance.m_sinks_owned.end(); ++it) {
+    if (async == true) {
+      (*it)->start(capacity, overflow);
+    } else {
+      (*it)->stop();
+    }
+  }
+
+  return m_instance.m_async;
+}
+
+const Histogram& Logger::latency(void) {
+  return m_instance.m_latency;
+}
+
+unsigned long long Logger::truncated(void) {
+  return m_instance.m_truncated.load(std::memory_order_relaxed);
+}
+
+unsigned long long Logger::dropped(void) {
+  unsigned long long rtn = 0;
+  std::lock_guard<std::mutex> guard(m_instance.m_mtx);
+
+  for (auto it = m_instance.m_sinks_owned.begin(); it != m_instance.m_sinks_owned.end(); ++it) {
+    rtn += (*it)->dropped();
+  }
+
+  return rtn;
+}
+
+Logger::tagBinaryBuffer& Logger::binaryBuffer(void) {
+  static thread_local tagBinaryBuffer rtn;
+
+  return rtn;
+}
+
+unsigned int Logger::binaryId(tagBinaryBuffer& tb, const char* format, bool braces) {
+  auto it = tb.ids.find(format);
+  if (it != tb.ids.end()) {
+    return it->second;
+  }
+
+  unsigned int id;
+  {
+    std::lock_guard<std::mutex> guard(m_binary_fmt_mtx);
+    auto found = m_binary_ids.find(format);
+    if (found == m_binary_ids.end()) {
+      id = static_cast<unsigned int>(m_binary_formats.size());
+      m_binary_formats.push_back(format);
+      m_binary_braces.push_back(braces);
+      m_binary_ids[format] = id;
+    } else {
+      id = found->second;
+    }
+  }
+  tb.ids[format] = id;
+
+  return id;
+}
+
+void Logger::logBinary(eLevel level, unsigned long long utmilli, const char* format, va_list args) {
+  tagBinaryBuffer& tb = binaryBuffer();
+  // registry lookups before tb.mtx, flush() takes them in the other order
+  unsigned int id = binaryId(tb, format, false);
+
+  {
+    std::lock_guard<std::mutex> lock(tb.mtx);
+    if (tb.data.empty() == true) {
+      tb.utmilli = utmilli;
+    }
+    binlog::encode(tb.data, id, static_cast<unsigned short>(level), utmilli, format, args);
+    checkBinary(tb, level, utmilli);
+  }
+
+  sweepBinary(utmilli);
+}
+
+void Logger::logBinary(eLevel level, const char* format, const std::string& args) {
+  unsigned long long utmilli = times::unixtimemillicoarse();
+  tagBinaryBuffer& tb = binaryBuffer();
+  unsigned int id = binaryId(tb, format, true);
+
+  {
+    std::lock_guard<std::mutex> lock(tb.mtx);
+    if (tb.data.empty() == true) {
+      tb.utmilli = utmilli;
+    }
+    binlog::encodeRecord(tb.data, id, static_cast<unsigned short>(level), utmilli, args);
+    checkBinary(tb, level, utmilli);
+  }
+
+  sweepBinary(utmilli);
+}
+
+void Logger::checkBinary(tagBinaryBuffer& tb, eLevel level, unsigned long long utmilli) {
+  if (tb.data.size() >= CB_COMMON_LOGGER_H_LEN_BINARY || level == eLevel::eError || utmilli - tb.utmilli >= CB_COMMON_LOGGER_H_BINARY_AGE) {
+    flushBinary(tb);
+  }
+}
+
+void Logger::sweepBinary(unsigned long long utmilli) {
+  // buffers of threads that went quiet are handed over by whoever logs next
+  unsigned long long flushed = m_binary_flushed.load(std::memory_order_relaxed);
+  if (utmilli - flushed >= CB_COMMON_LOGGER_H_BINARY_AGE && m_binary_flushed.compare_exchange_strong(flushed, utmilli) == true) {
+    collectBinary();
+  }
+}
+
+// every thread's buffer to the writer, without waiting for the file
+void Logger::collectBinary(void) {
+  std::lock_guard<std::mutex> guard(m_binary_mtx);
+
+  for (auto it = m_binary_buffers.begin(); it != m_binary_buffers.end(); ++it) {
+    std::lock_guard<std::mutex> lock((*it)->mtx);
+    flushBinary(**it);
+  }
+}
+
+// tb.mtx: the writer thread takes tb's data, tb goes on with a spare buffer
+void Logger::flushBinary(tagBinaryBuffer& tb) {
+  if (tb.data.empty() == true) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_binary_queue_mtx);
+    if (m_binary_writer.get() != nullptr) {
+      m_binary_cv_done.wait(lock, [this]() { return m_binary_queue.size() < CB_COMMON_LOGGER_H_LEN_BINARY_QUEUE; });
+      m_binary_queue.emplace_back();
+      m_binary_queue.back().data.swap(tb.data);
+      m_binary_queue.back().utmilli = tb.utmilli;
+      if (m_binary_spare.empty() == false) {
+        tb.data.swap(m_binary_spare.back());
+        m_binary_spare.pop_back();
+      }
+      ++m_binary_queued;
+      m_binary_cv_data.notify_one();
+    }
+  }
+
+  if (tb.data.empty() == false) {
+    // no writer: binary mode was never on, or the logger is going away
+    writeBinary(tb.data, tb.utmilli);
+    tb.data.clear();
+  } else if (tb.data.capacity() < CB_COMMON_LOGGER_H_LEN_BINARY) {
+    tb.data.reserve(CB_COMMON_LOGGER_H_LEN_BINARY);
+  }
+}
+
+void Logger::startBinary(void) {
+  std::lock_guard<std::mutex> lock(m_binary_queue_mtx);
+
+  if (m_binary_writer.get() == nullptr) {
+    m_binary_stop = false;
+    m_binary_writer.reset(new std::thread([this]() {
+      drainBinary();
+    }));
+  }
+}
+
+void Logger::stopBinary(void) {
+  std::deque<tagBinaryChunk> left;
+
+  {
+    std::lock_guard<std::mutex> lock(m_binary_queue_mtx);
+    if (m_binary_writer.get() == nullptr) {
+      return;
+    }
+    m_binary_stop = true;
+    m_binary_cv_data.notify_one();
+  }
+  m_binary_writer->join();
+
+  {
+    // handed over while it was joined
+    std::lock_guard<std::mutex> lock(m_binary_queue_mtx);
+    m_binary_writer.reset();
+    left.swap(m_binary_queue);
+    m_binary_written += left.size();
+    m_binary_cv_done.notify_all();
+  }
+  for (auto it = left.begin(); it != left.end(); ++it) {
+    writeBinary(it->data, it->utmilli);
+  }
+}
+
+// the writer thread: file I/O and m_mtx stay off the logging threads
+void Logger::drainBinary(void) {
+  tagBinaryChunk chunk;
+  std::unique_lock<std::mutex> lock(m_binary_queue_mtx);
+
+  for (;;) {
+    m_binary_cv_data.wait(lock, [this]() { return m_binary_stop == true || m_binary_queue.empty() == false; });
+    if (m_binary_queue.empty() == true) {
+      break;
+    }
+    chunk.data.swap(m_binary_queue.front().data);
+    chunk.utmilli = m_binary_queue.front().utmilli;
+    m_binary_queue.pop_front();
+    m_binary_cv_done.notify_all();
+    lock.unlock();
+
+    writeBinary(chunk.data, chunk.utmilli);
+    chunk.data.clear();
+
+    lock.lock();
+    if (m_binary_spare.size() < CB_COMMON_LOGGER_H_LEN_BINARY_QUEUE) {
+      m_binary_spare.emplace_back();
+      m_binary_spare.back().swap(chunk.data);
+    }
+    ++m_binary_written;
+    m_binary_cv_done.notify_all();
+  }
+}
+
+void Logger::writeBinary(const std::string& data, unsigned long long utmilli) {
+  struct tm tm_rec;
+  time_t rawtime = static_cast<time_t>(utmilli / 1000000);
+  char filename[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
+  std::string formats;
+
+  std::lock_guard<std::mutex> guard(m_mtx);
+
+  if (strlen(m_path) == 0) {
+    return;
+  }
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+  gmtime_s(&tm_rec, &rawtime);
+#else
+  gmtime_r(&rawtime, &tm_rec);
+#endif
+  unsigned long long key = LogSinkFile::periodKey(&tm_rec, m_split);
+
+  if (m_binary_fp == NULL || m_binary_key != key) {
+    if (m_binary_fp != NULL) {
+      fclose(m_binary_fp);
+    }
+
+    LogSinkFile::periodName(filename, m_path, m_split, &tm_rec, 0, ".blog");
+    m_binary_fp = fopen(filename, "ab");
+    if (m_binary_fp == NULL) {
+      return;
+    }
+    fwrite(binlog::MAGIC, 1, binlog::LEN_MAGIC, m_binary_fp);
+    m_binary_key = key;
+    // every file carries its own format frames
+    m_binary_defined.clear();
+  }
+
+  // define the formats this file hasn't seen yet
+  binlog::eachRecord(data, [this, &formats](unsigned int id) {
+    if (m_binary_defined.size() <= id) {
+      m_binary_defined.resize(id + 1, false);
+    }
+    if (m_binary_defined[id] == false) {
+      const char* format;
+      bool braces;
+      {
+        std::lock_guard<std::mutex> lock(m_binary_fmt_mtx);
+        format = m_binary_formats[id];
+        braces = m_binary_braces[id];
+      }
+      binlog::encodeFormat(formats, id, format, braces);
+      m_binary_defined[id] = true;
+    }
+  });
+
+  if (formats.empty() == false) {
+    fwrite(formats.data(), 1, formats.size(), m_binary_fp);
+  }
+  fwrite(data.data(), 1, data.size(), m_binary_fp);
+  fflush(m_binary_fp);
+}
+
+bool Logger::setBinary(bool binary) {
+  if (binary == false) {
+    m_instance.m_binary.store(false);
+    flush();
+  } else {
+    m_instance.startBinary();
+    m_instance.m_binary.store(true);
+  }
+
+  return m_instance.m_binary.load();
+}
+
+void Logger::flush(void) {
+  unsigned long long queued;
+
+  m_instance.collectBinary();
+
+  std::unique_lock<std::mutex> lock(m_instance.m_binary_queue_mtx);
+  queued = m_instance.m_binary_queued;
+  m_instance.m_binary_cv_done.wait(lock, [queued]() {
+    return m_instance.m_binary_written >= queued || m_instance.m_binary_writer.get() == nullptr;
+  });
+}
+
+Logger::eLevel Logger::setLevel(eLevel level) {
+  m_instance.m_level.store(static_cast<unsigned short>(level));
+
+  return level;
+}
+
 void Logger::log(eLevel level, const char* format, ...)
 {
   va_list argList;
 
-  struct tm* ptm;
-  char timeinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
-  char currinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
-  char filename[CB_COMMON_LOGGER_H_LEN_PATH] = { '\0' };
-  char filecontents[CB_COMMON_LOGGER_H_LEN_CONTENTS] = { '\0' };
+  if (enabled(level) == false) {
+    return;
+  }
 
-  ptm = times::iso8601(timeinfo, 0);
+  if (m_instance.m_binary.load() == true) {
+    va_start(argList, format);
+    m_instance.logBinary(level, times::unixtimemillicoarse(), format, argList);
+    va_end(argList);
 
-  strftime(currinfo, CB_DEFINES_H_LEN_ISO8601, "%Y-%m-%d-%H", ptm);
-  sprintf(&currinfo[strlen(currinfo)], "-%02d", ptm->tm_min / m_instance.m_split % m_instance.m_split);
-  //printf("-------------- %d / %s\n", m_instance.m_split, currinfo);
+    return;
+  }
 
-  strcpy(filename, m_instance.m_path);
-  filename[strlen(filename)] = PATH_SEP;
-  strcat(filename, "server.");
-  strcat(filename, currinfo);
-  strcat(filename, ".log");
+  tagRecord rec;
+  rec.utmilli = times::unixtimemillicoarse();
+  rec.level = level;
+  rec.contents[0] = '\0';
 
   va_start(argList, format);
-  vsprintf(filecontents, format, argList);
-  if (strlen(filecontents) == 0)
+  if (vsnprintf(rec.contents, CB_COMMON_LOGGER_H_LEN_CONTENTS, format, argList) >= CB_COMMON_LOGGER_H_LEN_CONTENTS) {
+    m_instance.truncate(rec);
+  }
+  if (strlen(rec.contents) == 0)
   {
-    sprintf(filecontents, "%s", format);
+    snprintf(rec.contents, CB_COMMON_LOGGER_H_LEN_CONTENTS, "%s", format);
   }
   va_end(argList);
 
-  m_instance.writeFile(level, timeinfo, currinfo, filename, filecontents);
+  m_instance.route(rec);
 
   //m_instance.m_mtx.lock();
   //m_instance.m_cnt++;
   //m_instance.m_mtx.unlock();
 }
 
+std::string& Logger::buffer(void) {
+  static thread_local std::string rtn;
+
+  // an unusually long line shouldn't stay allocated for the thread's lifetime
+  if (rtn.capacity() > CB_COMMON_LOGGER_H_LEN_FORMAT) {
+    std::string().swap(rtn);
+  }
+  rtn.clear();
+
+  return rtn;
+}
+
+void Logger::logText(eLevel level, const char* contents, std::size_t len) {
+  tagRecord rec;
+  rec.utmilli = times::unixtimemillicoarse();
+  rec.level = level;
+  if (len < CB_COMMON_LOGGER_H_LEN_CONTENTS) {
+    memcpy(rec.contents, contents, len);
+    rec.contents[len] = '\0';
+  } else {
+    memcpy(rec.contents, contents, CB_COMMON_LOGGER_H_LEN_CONTENTS - 1);
+    rec.contents[CB_COMMON_LOGGER_H_LEN_CONTENTS - 1] = '\0';
+    truncate(rec);
+  }
+
+  route(rec);
+}
+
+void Logger::truncate(tagRecord& rec) {
+  static const std::size_t len = sizeof(CB_COMMON_LOGGER_H_TRUNCATED);
+
+  // the marker's '\0' included
+  memcpy(&rec.contents[CB_COMMON_LOGGER_H_LEN_CONTENTS - len], CB_COMMON_LOGGER_H_TRUNCATED, len);
+  m_truncated.fetch_add(1, std::memory_order_relaxed);
+}
+
 const char* const Logger::LEVELS[] = {
   "ERROR",
   "WARN ",
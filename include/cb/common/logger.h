@@ -4,16 +4,76 @@
 #define CB_COMMON_LOGGER_H_
 
 #include <cstdio>
+#include <cstdarg>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "include/cb/common/defines.h"
+#include "include/cb/common/histogram.h"
+#include "include/cb/common/log_format.hpp"
+#include "include/cb/common/logger_binary.h"
 
 #define CB_COMMON_LOGGER_H_LEN_PATH 256
 #define CB_COMMON_LOGGER_H_LEN_CONTENTS 512
+#define CB_COMMON_LOGGER_H_LEN_QUEUE 8192
+#define CB_COMMON_LOGGER_H_LEN_BATCH 256
+#define CB_COMMON_LOGGER_H_LEN_BINARY 65536
+#define CB_COMMON_LOGGER_H_LEN_BINARY_QUEUE 64 // full binary buffers waiting for the writer thread, the logging one waits past that
+#define CB_COMMON_LOGGER_H_BINARY_AGE 1000000 // usec
+#define CB_COMMON_LOGGER_H_LEN_SEGMENT (64 * 1024 * 1024)
+#define CB_COMMON_LOGGER_H_LEN_SINKS 8
+#define CB_COMMON_LOGGER_H_LEN_FORMAT 4096 // per-thread buffer of print(), kept up to this size
+#define CB_COMMON_LOGGER_H_TRUNCATED " [...]" // ends a record cut to CB_COMMON_LOGGER_H_LEN_CONTENTS
+
+// compile-time ceiling: call sites above it are compiled out (0: eError ~ 3: eDebug)
+#ifndef CB_COMMON_LOGGER_H_LEVEL
+# ifdef NDEBUG
+#   define CB_COMMON_LOGGER_H_LEVEL 1
+# else
+#   define CB_COMMON_LOGGER_H_LEVEL 3
+# endif
+#endif
+
+// checks both thresholds before any argument is evaluated
+#define CB_LOG_ENABLED(level) \
+  (static_cast<unsigned short>(::cb::common::Logger::eLevel::level) <= CB_COMMON_LOGGER_H_LEVEL && \
+   ::cb::common::Logger::enabled(::cb::common::Logger::eLevel::level))
+#define CB_LOG(level, ...) \
+  do { \
+    if (CB_LOG_ENABLED(level)) { \
+      ::cb::common::Logger::log(::cb::common::Logger::eLevel::level, __VA_ARGS__); \
+    } \
+  } while (0)
+#define CB_LOG_ERROR(...) CB_LOG(eError, __VA_ARGS__)
+#define CB_LOG_WARN(...) CB_LOG(eWarn, __VA_ARGS__)
+#define CB_LOG_INFO(...) CB_LOG(eInfo, __VA_ARGS__)
+#define CB_LOG_DEBUG(...) CB_LOG(eDebug, __VA_ARGS__)
+// type-safe "{}" formats (see log_format.hpp), checked at compile time even when compiled out
+#define CB_LOGF(level, ...) \
+  do { \
+    CB_COMMON_LOG_FORMAT_HPP_CHECK(__VA_ARGS__); \
+    if (CB_LOG_ENABLED(level)) { \
+      ::cb::common::Logger::print(::cb::common::Logger::eLevel::level, __VA_ARGS__); \
+    } \
+  } while (0)
+#define CB_LOGF_ERROR(...) CB_LOGF(eError, __VA_ARGS__)
+#define CB_LOGF_WARN(...) CB_LOGF(eWarn, __VA_ARGS__)
+#define CB_LOGF_INFO(...) CB_LOGF(eInfo, __VA_ARGS__)
+#define CB_LOGF_DEBUG(...) CB_LOGF(eDebug, __VA_ARGS__)
 
 namespace cb {
 namespace common {
 
+class LogSink;
+class LogSinkFile;
+
 class Logger {
  public:
   enum class eLevel : unsigned short {
@@ -24,6 +84,28 @@ class Logger {
   };
   static const char* const LEVELS[];
 
+  // behaviour of an async sink when its queue is full
+  enum class eOverflow : unsigned short {
+    eBlock = 0,  // wait for the writer thread
+    eDropNewest, // discard the record being logged
+    eDropOldest, // discard the oldest queued record
+  };
+
+  typedef struct {
+    unsigned long long utmilli;
+    eLevel level;
+    char contents[CB_COMMON_LOGGER_H_LEN_CONTENTS];
+  } tagRecord;
+
+ private:
+  struct tagBinaryBuffer;
+
+  // a per-thread buffer taken over by the writer thread
+  typedef struct {
+    std::string data;
+    unsigned long long utmilli;
+  } tagBinaryChunk;
+
  private:
   Logger(void);
   Logger(const Logger& rhs);
@@ -35,20 +117,119 @@ class Logger {
   unsigned int m_cnt;
   unsigned int m_split;
   char m_path[CB_COMMON_LOGGER_H_LEN_PATH];
-  char m_currinfo[CB_DEFINES_H_LEN_ISO8601];
-  FILE* m_fp;
+  std::atomic<unsigned short> m_level;
+
+  // sinks: m_sinks is read without a lock, m_sinks_owned (m_mtx) keeps them alive
+  std::atomic<LogSink*> m_sinks[CB_COMMON_LOGGER_H_LEN_SINKS];
+  std::vector<std::shared_ptr<LogSink>> m_sinks_owned;
+  std::atomic<unsigned int> m_inflight;
+  std::atomic<unsigned long long> m_truncated;
+  Histogram m_latency; // nsec spent handing a record to the sinks
+  std::shared_ptr<LogSinkFile> m_file; // default sinks
+  std::shared_ptr<LogSink> m_console;
+  // async settings, applied to every sink added
+  bool m_async;
+  unsigned int m_capacity;
+  eOverflow m_overflow;
+
+  // binary mode
+  std::atomic<bool> m_binary;
+  std::atomic<unsigned long long> m_binary_flushed; // utmilli of the last flush of every buffer
+  std::mutex m_binary_mtx;     // m_binary_buffers
+  std::mutex m_binary_fmt_mtx; // m_binary_ids, m_binary_formats
+  std::unordered_map<const char*, unsigned int> m_binary_ids;
+  std::vector<const char*> m_binary_formats;
+  std::vector<bool> m_binary_braces; // per id: a "{}" format
+  std::vector<tagBinaryBuffer*> m_binary_buffers;
+  FILE* m_binary_fp; // m_mtx
+  unsigned long long m_binary_key;
+  std::vector<bool> m_binary_defined;
+  // the file is written by m_binary_writer alone, the logging threads only hand their buffers over
+  std::mutex m_binary_queue_mtx; // below
+  std::condition_variable m_binary_cv_data;
+  std::condition_variable m_binary_cv_done; // a chunk was taken or written
+  std::deque<tagBinaryChunk> m_binary_queue;
+  std::vector<std::string> m_binary_spare; // written out, reserved, back to the logging threads
+  unsigned long long m_binary_queued;
+  unsigned long long m_binary_written;
+  bool m_binary_stop;
+  std::unique_ptr<std::thread> m_binary_writer;
 
  public:
+  // the default "file" sink
   static unsigned int setSplit(unsigned int split);
   static bool setPath(const char* path);
+  // size of the preallocated log segments, 0 goes back to fopen/fprintf
+  static std::size_t setSegment(std::size_t capacity);
+  // records go to every sink ("file" and "console" by default), each with its own level
+  static bool addSink(std::shared_ptr<LogSink> sink);
+  static bool removeSink(const char* name);
+  static std::shared_ptr<LogSink> sink(const char* name);
+  // async: every sink queues records and writes them from its own thread, flushing once per batch.
+  // turning it off drains everything queued so far before returning.
+  static bool setAsync(bool async, unsigned int capacity = CB_COMMON_LOGGER_H_LEN_QUEUE, eOverflow overflow = eOverflow::eBlock);
+  static unsigned long long dropped(void);
+  // records longer than CB_COMMON_LOGGER_H_LEN_CONTENTS, cut and marked with CB_COMMON_LOGGER_H_TRUNCATED
+  static unsigned long long truncated(void);
+  // nsec each record took to reach every sink (queueing or writing, blocking included)
+  static const Histogram& latency(void);
+  // binary: only the format id, timestamp and raw arguments are kept in per-thread buffers
+  // and written as server.*.blog (see logger_binary.h). formats must be string literals.
+  static bool setBinary(bool binary);
+  // writes out every per-thread binary buffer, returns once they're in the file
+  static void flush(void);
+  // runtime threshold, records above it are discarded before formatting
+  static eLevel setLevel(eLevel level);
+  static inline bool enabled(eLevel level) {
+    return static_cast<unsigned short>(level) <= m_instance.m_level.load(std::memory_order_relaxed);
+  }
+  // printf formats, kept for existing callers
   static void log(eLevel level, const char* format, ...);
+  // "{}" formats, arguments are type-checked and formatted into a per-thread buffer.
+  // in binary mode they're kept as they are (binlog::BinaryArg) and formatted when decoded.
+  template <typename... Args>
+  static void print(eLevel level, const char* format, const Args&... args);
 
  private:
-  void writeFile(eLevel level, const char* timeinfo, const char* currinfo, const char* filename, const char* filecontents);
+  static std::string& buffer(void);
+  static tagBinaryBuffer& binaryBuffer(void);
+  void logText(eLevel level, const char* contents, std::size_t len);
+  // the end of a record that didn't fit
+  void truncate(tagRecord& rec);
+  void route(const tagRecord& rec);
+  unsigned int binaryId(tagBinaryBuffer& tb, const char* format, bool braces);
+  void logBinary(eLevel level, unsigned long long utmilli, const char* format, va_list args);
+  // args: encoded by binlog::encodeArgs
+  void logBinary(eLevel level, const char* format, const std::string& args);
+  // tb.mtx: hands tb over when it's full, aged or got an error
+  void checkBinary(tagBinaryBuffer& tb, eLevel level, unsigned long long utmilli);
+  void sweepBinary(unsigned long long utmilli);
+  void collectBinary(void);
+  void flushBinary(tagBinaryBuffer& tb);
+  void startBinary(void);
+  void stopBinary(void);
+  void drainBinary(void);
+  void writeBinary(const std::string& data, unsigned long long utmilli);
  private:
   static Logger m_instance;
 };
 
+template <typename... Args>
+void Logger::print(eLevel level, const char* format, const Args&... args) {
+  if (enabled(level) == false) {
+    return;
+  }
+
+  std::string& buf = buffer();
+  if (m_instance.m_binary.load() == true) {
+    binlog::encodeArgs(buf, args...);
+    m_instance.logBinary(level, format, buf);
+    return;
+  }
+  logfmt::format(buf, format, args...);
+  m_instance.logText(level, buf.data(), buf.size());
+}
+
 } // namespace common
 } // namespace cb
 
@@ -0,0 +1,557 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstring>
+#include <cstdarg>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/cb/common/defines.h"
+#include "include/cb/common/times.h"
+#include "include/cb/common/logger.h"
+#include "include/cb/common/logger_binary.h"
+
+namespace {
+
+enum class eLength : unsigned short {
+  eNone = 0,
+  eChar,      // hh
+  eShort,     // h
+  eLong,      // l
+  eLongLong,  // ll, j, q
+  eSize,      // z, t
+  eLongDouble // L
+};
+
+typedef struct {
+  const char* begin; // '%'
+  const char* end;   // one past the conversion
+  bool width_star;
+  bool prec_star;
+  eLength length;
+  char conv;
+} tagSpec;
+
+// next conversion of a printf format, NULL when there is none left
+const char* nextSpec(const char* p, tagSpec& spec) {
+  for (; *p != '\0'; ++p) {
+    if (*p != '%') {
+      continue;
+    }
+    if (*(p + 1) == '%') {
+      ++p;
+      continue;
+    }
+
+    spec.begin = p++;
+    spec.width_star = false;
+    spec.prec_star = false;
+    spec.length = eLength::eNone;
+
+    while (*p != '\0' && strchr("-+ #0'", *p) != NULL) {
+      ++p;
+    }
+    if (*p == '*') {
+      spec.width_star = true;
+      ++p;
+    }
+    while (*p >= '0' && *p <= '9') {
+      ++p;
+    }
+    if (*p == '.') {
+      ++p;
+      if (*p == '*') {
+        spec.prec_star = true;
+        ++p;
+      }
+      while (*p >= '0' && *p <= '9') {
+        ++p;
+      }
+    }
+
+    switch (*p) {
+    case 'h':
+      spec.length = (*(p + 1) == 'h') ? eLength::eChar : eLength::eShort;
+      p += (*(p + 1) == 'h') ? 2 : 1;
+      break;
+    case 'l':
+      spec.length = (*(p + 1) == 'l') ? eLength::eLongLong : eLength::eLong;
+      p += (*(p + 1) == 'l') ? 2 : 1;
+      break;
+    case 'j':
+    case 'q':
+      spec.length = eLength::eLongLong;
+      ++p;
+      break;
+    case 'z':
+    case 't':
+      spec.length = eLength::eSize;
+      ++p;
+      break;
+    case 'L':
+      spec.length = eLength::eLongDouble;
+      ++p;
+      break;
+    default:
+      break;
+    }
+
+    if (*p == '\0') {
+      return NULL;
+    }
+    spec.conv = *p;
+    spec.end = p + 1;
+
+    return spec.end;
+  }
+
+  return NULL;
+}
+
+void putZigzag(std::string& buf, long long v) {
+  ::cb::common::binlog::putVarint(buf, (static_cast<unsigned long long>(v) << 1) ^ static_cast<unsigned long long>(v >> 63));
+}
+
+long long getZigzag(unsigned long long v) {
+  return static_cast<long long>(v >> 1) ^ -static_cast<long long>(v & 1);
+}
+
+// printf a single conversion, with its '*' values
+template <typename V>
+void emit(std::string& out, const tagSpec& spec, const int* stars, int nstars, V v) {
+  char fmt[64] = { '\0' };
+  char buf[256] = { '\0' };
+  std::size_t len = std::min<std::size_t>(spec.end - spec.begin, sizeof(fmt) - 1);
+  int n = 0;
+
+  memcpy(fmt, spec.begin, len);
+  fmt[len] = '\0';
+
+  for (int pass = 0; pass < 2; ++pass) {
+    char* dst = (pass == 0) ? buf : &out[out.size() - n - 1];
+    std::size_t cap = (pass == 0) ? sizeof(buf) : static_cast<std::size_t>(n) + 1;
+    int r;
+    switch (nstars) {
+    case 2:  r = snprintf(dst, cap, fmt, stars[0], stars[1], v); break;
+    case 1:  r = snprintf(dst, cap, fmt, stars[0], v); break;
+    default: r = snprintf(dst, cap, fmt, v); break;
+    }
+    if (r < 0) {
+      return;
+    }
+    if (pass == 0) {
+      n = r;
+      if (static_cast<std::size_t>(r) < sizeof(buf)) {
+        out.append(buf, r);
+        return;
+      }
+      // too long for the scratch buffer, print in place
+      out.resize(out.size() + n + 1);
+    } else {
+      out.resize(out.size() - 1);
+    }
+  }
+}
+
+// the message of a printf format's record
+bool decodePrintf(const char* p, const char* end, const char* format, std::string& message) {
+  unsigned long long v;
+  tagSpec spec;
+  int stars[2];
+  int nstars;
+
+  const char* lit = format;
+  const char* next;
+  while ((next = nextSpec(lit, spec)) != NULL) {
+    // literal text, with "%%" collapsed
+    for (const char* q = lit; q < spec.begin; ++q) {
+      message.push_back(*q);
+      if (*q == '%') {
+        ++q;
+      }
+    }
+
+    nstars = 0;
+    if (spec.width_star == true) {
+      if (::cb::common::binlog::getVarint(p, end, v) == false) {
+        return false;
+      }
+      stars[nstars++] = static_cast<int>(getZigzag(v));
+    }
+    if (spec.prec_star == true) {
+      if (::cb::common::binlog::getVarint(p, end, v) == false) {
+        return false;
+      }
+      stars[nstars++] = static_cast<int>(getZigzag(v));
+    }
+
+    switch (spec.conv) {
+    case 'd':
+    case 'i':
+      if (::cb::common::binlog::getVarint(p, end, v) == false) {
+        return false;
+      }
+      switch (spec.length) {
+      case eLength::eLong:     emit(message, spec, stars, nstars, static_cast<long>(getZigzag(v))); break;
+      case eLength::eLongLong: emit(message, spec, stars, nstars, getZigzag(v)); break;
+      case eLength::eSize:     emit(message, spec, stars, nstars, static_cast<std::ptrdiff_t>(getZigzag(v))); break;
+      default:                 emit(message, spec, stars, nstars, static_cast<int>(getZigzag(v))); break;
+      }
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+      if (::cb::common::binlog::getVarint(p, end, v) == false) {
+        return false;
+      }
+      switch (spec.length) {
+      case eLength::eLong:     emit(message, spec, stars, nstars, static_cast<unsigned long>(v)); break;
+      case eLength::eLongLong: emit(message, spec, stars, nstars, v); break;
+      case eLength::eSize:     emit(message, spec, stars, nstars, static_cast<std::size_t>(v)); break;
+      default:                 emit(message, spec, stars, nstars, static_cast<unsigned int>(v)); break;
+      }
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      {
+        double d;
+        if (end - p < static_cast<std::ptrdiff_t>(sizeof(d))) {
+          return false;
+        }
+        memcpy(&d, p, sizeof(d));
+        p += sizeof(d);
+        if (spec.length == eLength::eLongDouble) {
+          emit(message, spec, stars, nstars, static_cast<long double>(d));
+        } else {
+          emit(message, spec, stars, nstars, d);
+        }
+      }
+      break;
+    case 's':
+      {
+        if (::cb::common::binlog::getVarint(p, end, v) == false || static_cast<unsigned long long>(end - p) < v) {
+          return false;
+        }
+        std::string s(p, static_cast<std::size_t>(v));
+        p += v;
+        emit(message, spec, stars, nstars, s.c_str());
+      }
+      break;
+    case 'p':
+      if (::cb::common::binlog::getVarint(p, end, v) == false) {
+        return false;
+      }
+      emit(message, spec, stars, nstars, reinterpret_cast<void*>(static_cast<std::size_t>(v)));
+      break;
+    default:
+      // %n and unknown conversions carry nothing
+      break;
+    }
+
+    lit = next;
+  }
+  for (const char* q = lit; *q != '\0'; ++q) {
+    message.push_back(*q);
+    if (*q == '%' && *(q + 1) == '%') {
+      ++q;
+    }
+  }
+
+  return true;
+}
+
+// the message of a "{}" format's record, each argument rendered as logfmt would have
+bool decodeBraces(const char* p, const char* end, const char* format, std::string& message) {
+  unsigned long long v;
+
+  while (::cb::common::logfmt::next(message, format) == true) {
+    if (p >= end) {
+      message.append("{}");
+      continue;
+    }
+
+    ::cb::common::binlog::eArg type = static_cast<::cb::common::binlog::eArg>(*p++);
+    if (type == ::cb::common::binlog::eArg::eDouble) {
+      double d;
+      if (end - p < static_cast<std::ptrdiff_t>(sizeof(d))) {
+        return false;
+      }
+      memcpy(&d, p, sizeof(d));
+      p += sizeof(d);
+      ::cb::common::logfmt::FormatArg<double>::append(message, d);
+      continue;
+    }
+    if (type == ::cb::common::binlog::eArg::eChar || type == ::cb::common::binlog::eArg::eBool) {
+      if (p >= end) {
+        return false;
+      }
+      if (type == ::cb::common::binlog::eArg::eChar) {
+        message.push_back(*p);
+      } else {
+        message.append((*p != 0) ? "true" : "false");
+      }
+      ++p;
+      continue;
+    }
+
+    if (::cb::common::binlog::getVarint(p, end, v) == false) {
+      return false;
+    }
+    switch (type) {
+    case ::cb::common::binlog::eArg::eSigned:
+      ::cb::common::logfmt::appendInteger(message, getZigzag(v));
+      break;
+    case ::cb::common::binlog::eArg::eUnsigned:
+      ::cb::common::logfmt::appendInteger(message, v);
+      break;
+    case ::cb::common::binlog::eArg::eString:
+      if (static_cast<unsigned long long>(end - p) < v) {
+        return false;
+      }
+      message.append(p, static_cast<std::size_t>(v));
+      p += v;
+      break;
+    case ::cb::common::binlog::eArg::ePointer:
+      ::cb::common::logfmt::FormatArg<const void*>::append(message, reinterpret_cast<const void*>(static_cast<std::uintptr_t>(v)));
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool decodeRecord(const char* p, const char* end, const std::vector<std::string>& formats, const std::vector<bool>& braces, FILE* out) {
+  unsigned long long id, utmilli;
+  unsigned short level;
+  char timeinfo[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
+  std::string message;
+  bool rtn;
+
+  if (::cb::common::binlog::getVarint(p, end, id) == false || id >= formats.size() || p >= end) {
+    return false;
+  }
+  level = static_cast<unsigned char>(*p++);
+  if (::cb::common::binlog::getVarint(p, end, utmilli) == false || level > static_cast<unsigned short>(::cb::common::Logger::eLevel::eDebug)) {
+    return false;
+  }
+
+  if (id < braces.size() && braces[id] == true) {
+    rtn = decodeBraces(p, end, formats[id].c_str(), message);
+  } else {
+    rtn = decodePrintf(p, end, formats[id].c_str(), message);
+  }
+  if (rtn == false) {
+    return false;
+  }
+
+  ::cb::common::times::iso8601(timeinfo, utmilli);
+  fprintf(out, "[%s][%s] %s\n", timeinfo, ::cb::common::Logger::LEVELS[level], message.c_str());
+
+  return true;
+}
+
+} // namespace
+
+namespace cb {
+namespace common {
+
+namespace binlog {
+
+void putVarint(std::string& buf, unsigned long long v) {
+  while (v >= 0x80) {
+    buf.push_back(static_cast<char>((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  buf.push_back(static_cast<char>(v));
+}
+
+bool getVarint(const char*& p, const char* end, unsigned long long& v) {
+  unsigned int shift = 0;
+
+  v = 0;
+  while (p < end && shift < 64) {
+    unsigned char c = static_cast<unsigned char>(*p++);
+    v |= static_cast<unsigned long long>(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+    shift += 7;
+  }
+
+  return false;
+}
+
+void encode(std::string& buf, unsigned int id, unsigned short level, unsigned long long utmilli, const char* format, va_list args) {
+  std::string payload;
+  tagSpec spec;
+  const char* p = format;
+
+  putVarint(payload, id);
+  payload.push_back(static_cast<char>(level));
+  putVarint(payload, utmilli);
+
+  while ((p = nextSpec(p, spec)) != NULL) {
+    if (spec.width_star == true) {
+      putZigzag(payload, va_arg(args, int));
+    }
+    if (spec.prec_star == true) {
+      putZigzag(payload, va_arg(args, int));
+    }
+
+    switch (spec.conv) {
+    case 'd':
+    case 'i':
+      switch (spec.length) {
+      case eLength::eLong:     putZigzag(payload, va_arg(args, long)); break;
+      case eLength::eLongLong: putZigzag(payload, va_arg(args, long long)); break;
+      case eLength::eSize:     putZigzag(payload, va_arg(args, std::ptrdiff_t)); break;
+      default:                 putZigzag(payload, va_arg(args, int)); break;
+      }
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+    case 'c':
+      switch (spec.length) {
+      case eLength::eLong:     putVarint(payload, va_arg(args, unsigned long)); break;
+      case eLength::eLongLong: putVarint(payload, va_arg(args, unsigned long long)); break;
+      case eLength::eSize:     putVarint(payload, va_arg(args, std::size_t)); break;
+      default:                 putVarint(payload, va_arg(args, unsigned int)); break;
+      }
+      break;
+    case 'e':
+    case 'E':
+    case 'f':
+    case 'F':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      {
+        double d = (spec.length == eLength::eLongDouble) ? static_cast<double>(va_arg(args, long double)) : va_arg(args, double);
+        payload.append(reinterpret_cast<const char*>(&d), sizeof(d));
+      }
+      break;
+    case 's':
+      {
+        const char* s = va_arg(args, const char*);
+        if (s == NULL) {
+          s = "(null)";
+        }
+        std::size_t len = strlen(s);
+        putVarint(payload, len);
+        payload.append(s, len);
+      }
+      break;
+    case 'p':
+      putVarint(payload, reinterpret_cast<std::size_t>(va_arg(args, void*)));
+      break;
+    case 'n':
+      va_arg(args, void*);
+      break;
+    default:
+      break;
+    }
+  }
+
+  buf.push_back(static_cast<char>(eFrame::eRecord));
+  putVarint(buf, payload.size());
+  buf.append(payload);
+}
+
+void encodeRecord(std::string& buf, unsigned int id, unsigned short level, unsigned long long utmilli, const std::string& args) {
+  std::string payload;
+
+  putVarint(payload, id);
+  payload.push_back(static_cast<char>(level));
+  putVarint(payload, utmilli);
+  payload.append(args);
+
+  buf.push_back(static_cast<char>(eFrame::eRecord));
+  putVarint(buf, payload.size());
+  buf.append(payload);
+}
+
+void encodeFormat(std::string& buf, unsigned int id, const char* format, bool braces) {
+  std::string payload;
+
+  putVarint(payload, id);
+  payload.append(format);
+
+  buf.push_back(static_cast<char>((braces == true) ? eFrame::eBraces : eFrame::eFormat));
+  putVarint(buf, payload.size());
+  buf.append(payload);
+}
+
+bool decode(FILE* in, FILE* out) {
+  std::string data;
+  std::vector<std::string> formats;
+  std::vector<bool> braces;
+  char chunk[4096];
+  std::size_t n;
+
+  while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    data.append(chunk, n);
+  }
+
+  const char* p = data.data();
+  const char* end = p + data.size();
+  unsigned long long len, id;
+
+  // files are appended to across restarts, so the magic may repeat
+  while (p < end) {
+    if (static_cast<std::size_t>(end - p) >= LEN_MAGIC && memcmp(p, MAGIC, LEN_MAGIC) == 0) {
+      p += LEN_MAGIC;
+      continue;
+    }
+
+    eFrame type = static_cast<eFrame>(*p++);
+    if (getVarint(p, end, len) == false || static_cast<unsigned long long>(end - p) < len) {
+      return false;
+    }
+    const char* payload = p;
+    p += len;
+
+    switch (type) {
+    case eFrame::eFormat:
+    case eFrame::eBraces:
+      if (getVarint(payload, p, id) == false) {
+        return false;
+      }
+      if (formats.size() <= id) {
+        formats.resize(static_cast<std::size_t>(id) + 1);
+        braces.resize(static_cast<std::size_t>(id) + 1, false);
+      }
+      formats[static_cast<std::size_t>(id)].assign(payload, p);
+      braces[static_cast<std::size_t>(id)] = (type == eFrame::eBraces);
+      break;
+    case eFrame::eRecord:
+      if (decodeRecord(payload, p, formats, braces, out) == false) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace binlog
+
+} // namespace common
+} // namespace cb
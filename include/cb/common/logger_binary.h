@@ -0,0 +1,222 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef CB_COMMON_LOGGER_BINARY_H_
+#define CB_COMMON_LOGGER_BINARY_H_
+
+#include <cstdio>
+#include <cstdarg>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "include/cb/common/log_format.hpp"
+
+namespace cb {
+namespace common {
+
+// deferred binary log codec
+//
+// file   : MAGIC frame*
+// frame  : type(1) length(varint) payload(length)
+// format : id(varint) format-bytes
+// record : id(varint) level(1) utmilli(varint) argument*
+//
+// integer arguments are zigzag/plain varints, floating ones are 8 raw bytes (host order),
+// strings are length(varint) bytes and '*' width/precision values precede their argument.
+// a "{}" format (eBraces) is typeless, so each of its record's arguments starts with its eArg.
+// a format frame always appears before the first record that refers to it in the same file.
+namespace binlog {
+
+static const char MAGIC[] = { 'C', 'B', 'L', 'G', 0x01, '\n' };
+static const std::size_t LEN_MAGIC = sizeof(MAGIC);
+
+enum class eFrame : unsigned char {
+  eFormat = 1,
+  eRecord = 2,
+  eBraces = 3, // a "{}" format
+};
+
+// type of a "{}" argument
+enum class eArg : unsigned char {
+  eSigned = 1,
+  eUnsigned,
+  eDouble,
+  eString,
+  eChar,
+  eBool,
+  ePointer,
+};
+
+void putVarint(std::string& buf, unsigned long long v);
+bool getVarint(const char*& p, const char* end, unsigned long long& v);
+
+// appends a record frame, the arguments are consumed according to the printf format
+void encode(std::string& buf, unsigned int id, unsigned short level, unsigned long long utmilli, const char* format, va_list args);
+// appends a record frame of a "{}" format, args from encodeArgs()
+void encodeRecord(std::string& buf, unsigned int id, unsigned short level, unsigned long long utmilli, const std::string& args);
+// appends a format frame
+void encodeFormat(std::string& buf, unsigned int id, const char* format, bool braces = false);
+// appends the arguments of a "{}" format. types without a BinaryArg are formatted (logfmt::FormatArg) and kept as strings
+template <typename... Args>
+void encodeArgs(std::string& buf, const Args&... args);
+// walks the frames of buf, calls fn(id) for each record frame
+template <typename Fn>
+bool eachRecord(const std::string& buf, Fn fn);
+
+// writes "[timestamp][LEVEL] message" lines for every record of a binary log file
+bool decode(FILE* in, FILE* out);
+
+template <typename T, typename Enable = void>
+struct BinaryArg {
+  static void put(std::string& buf, const T& v) {
+    std::string text;
+    logfmt::FormatArg<T>::append(text, v);
+    buf.push_back(static_cast<char>(eArg::eString));
+    putVarint(buf, text.size());
+    buf.append(text);
+  }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value && !std::is_same<T, char>::value>::type> {
+  static void put(std::string& buf, T v) {
+    if (std::is_signed<T>::value == true) {
+      long long s = static_cast<long long>(v);
+      buf.push_back(static_cast<char>(eArg::eSigned));
+      putVarint(buf, (static_cast<unsigned long long>(s) << 1) ^ static_cast<unsigned long long>(s >> 63));
+    } else {
+      buf.push_back(static_cast<char>(eArg::eUnsigned));
+      putVarint(buf, static_cast<unsigned long long>(v));
+    }
+  }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+  static void put(std::string& buf, T v) {
+    double d = static_cast<double>(v);
+    buf.push_back(static_cast<char>(eArg::eDouble));
+    buf.append(reinterpret_cast<const char*>(&d), sizeof(d));
+  }
+};
+
+template <typename T>
+struct BinaryArg<T, typename std::enable_if<std::is_enum<T>::value>::type> {
+  static void put(std::string& buf, T v) {
+    typedef typename std::underlying_type<T>::type U;
+    BinaryArg<U>::put(buf, static_cast<U>(v));
+  }
+};
+
+template <>
+struct BinaryArg<bool> {
+  static void put(std::string& buf, bool v) {
+    buf.push_back(static_cast<char>(eArg::eBool));
+    buf.push_back((v == true) ? 1 : 0);
+  }
+};
+
+template <>
+struct BinaryArg<char> {
+  static void put(std::string& buf, char v) {
+    buf.push_back(static_cast<char>(eArg::eChar));
+    buf.push_back(v);
+  }
+};
+
+template <>
+struct BinaryArg<const char*> {
+  static void put(std::string& buf, const char* v) {
+    std::size_t len;
+    if (v == NULL) {
+      v = "(null)";
+    }
+    len = strlen(v);
+    buf.push_back(static_cast<char>(eArg::eString));
+    putVarint(buf, len);
+    buf.append(v, len);
+  }
+};
+
+template <>
+struct BinaryArg<char*> : BinaryArg<const char*> {};
+
+// string literals, and char buffers which may not be terminated
+template <std::size_t N>
+struct BinaryArg<char[N]> {
+  static void put(std::string& buf, const char (&v)[N]) {
+    const void* end = memchr(v, '\0', N);
+    std::size_t len = (end != NULL) ? static_cast<const char*>(end) - v : N;
+    buf.push_back(static_cast<char>(eArg::eString));
+    putVarint(buf, len);
+    buf.append(v, len);
+  }
+};
+
+template <>
+struct BinaryArg<std::string> {
+  static void put(std::string& buf, const std::string& v) {
+    buf.push_back(static_cast<char>(eArg::eString));
+    putVarint(buf, v.size());
+    buf.append(v);
+  }
+};
+
+#if __cplusplus >= 201703L
+template <>
+struct BinaryArg<std::string_view> {
+  static void put(std::string& buf, std::string_view v) {
+    buf.push_back(static_cast<char>(eArg::eString));
+    putVarint(buf, v.size());
+    buf.append(v.data(), v.size());
+  }
+};
+#endif
+
+// other pointers as addresses
+template <typename T>
+struct BinaryArg<T*> {
+  static void put(std::string& buf, const T* v) {
+    buf.push_back(static_cast<char>(eArg::ePointer));
+    putVarint(buf, reinterpret_cast<std::uintptr_t>(v));
+  }
+};
+
+template <typename... Args>
+void encodeArgs(std::string& buf, const Args&... args) {
+  // braced initializers are evaluated in order
+  int expand[] = { 0, (BinaryArg<Args>::put(buf, args), 0)... };
+  (void)expand;
+}
+
+template <typename Fn>
+bool eachRecord(const std::string& buf, Fn fn) {
+  const char* p = buf.data();
+  const char* end = p + buf.size();
+  unsigned long long len, id;
+
+  while (p < end) {
+    eFrame type = static_cast<eFrame>(*p++);
+    if (getVarint(p, end, len) == false || static_cast<unsigned long long>(end - p) < len) {
+      return false;
+    }
+    const char* payload = p;
+    if (type == eFrame::eRecord) {
+      if (getVarint(payload, p + len, id) == false) {
+        return false;
+      }
+      fn(static_cast<unsigned int>(id));
+    }
+    p += len;
+  }
+
+  return true;
+}
+
+} // namespace binlog
+
+} // namespace common
+} // namespace cb
+
+#endif
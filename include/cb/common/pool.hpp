@@ -1,13 +1,34 @@
 #ifndef CB_COMMON_POOL_HPP_
 #define CB_COMMON_POOL_HPP_
 
+#include <cstdio>
 #include <ctime>
-#include <vector>
-#include <functional> // hash
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "include/cb/common/defines.h"
+#include "include/cb/common/histogram.h"
 #include "include/cb/common/logger.h"
+#include "include/cb/common/times.h"
+
+#define CB_COMMON_POOL_HPP_NIL 0xffffffffU
+#define CB_COMMON_POOL_HPP_LEN_CACHELINE 64
+#define CB_COMMON_POOL_HPP_LEN_PREWARM 16 // threads connecting the initial resources
+#define CB_COMMON_POOL_HPP_INTERVAL 1 // sec, health checks of the elastic pool
+#define CB_COMMON_POOL_HPP_VALIDATE 30 // sec, idle resources are validated at most this often
+#define CB_COMMON_POOL_HPP_LEAK 60000 // msec, a lease held longer is reported
 
 namespace cb {
 namespace common {
@@ -16,18 +37,126 @@ class IPoolResource {
  public:
   virtual bool connect() = 0;
   virtual bool disconnect() = 0;
+  // cheap liveness check of an idle connection (e.g. a ping), false has it reconnected
+  virtual bool validate() { return true; }
 };
 
 template <typename T>
 struct tagPoolBody {
   T* body; // class T : public IPoolResource
   int timeout;
-  time_t past;
-  short use;
+  // owner only (whoever took it from a stack)
+  time_t past; // last taken / released / reconnected
+  time_t checked; // last validated
+  bool live; // constructed
+  bool connected;
+  std::atomic<short> use;
+  std::atomic<unsigned int> next; // free list
+  // read by stats() while in use
+  std::atomic<unsigned long long> taken; // times::cycles(), 0 while free
+  std::atomic<unsigned long long> owner; // hash of the thread that took it
+  std::atomic<bool> reported; // as held too long
+};
+
+// a lease held longer than the leak threshold
+struct tagPoolLeak {
+  unsigned int slot;
+  unsigned long long thread; // std::hash<std::thread::id> of the thread that took it
+  unsigned long long held; // nsec
+};
+
+// Pool<T>::stats(), counters since set() / configure()
+struct tagPoolStats {
+  int size; // slots (max)
+  int live; // constructed resources
+  int in_use;
+  int idle;
+  unsigned int waiting;
+  unsigned long long acquired;
+  unsigned long long timeouts; // get_for() / lease_for() that gave up
+  unsigned long long reconnects;
+  // nsec
+  unsigned long long wait_p50;
+  unsigned long long wait_p99;
+  unsigned long long wait_max;
+  unsigned long long hold_p50;
+  unsigned long long hold_p99;
+  unsigned long long hold_max;
+  std::vector<tagPoolLeak> leaks;
+
+  // "live=.. in_use=.. idle=.. waiting=.. ..." in usec
+  std::string summary(void) const;
+};
+
+inline std::string tagPoolStats::summary(void) const {
+  char rtn[512];
+
+  snprintf(rtn, sizeof(rtn),
+    "live=%d/%d in_use=%d idle=%d waiting=%u acquired=%llu timeouts=%llu reconnects=%llu leaks=%u"
+    " wait_usec(p50=%llu p99=%llu max=%llu) hold_usec(p50=%llu p99=%llu max=%llu)",
+    live, size, in_use, idle, waiting, acquired, timeouts, reconnects, static_cast<unsigned int>(leaks.size()),
+    wait_p50 / 1000, wait_p99 / 1000, wait_max / 1000, hold_p50 / 1000, hold_p99 / 1000, hold_max / 1000);
+
+  return std::string(rtn);
+}
+
+// a slot per cache line, neighbours taken by other threads don't invalidate it
+template <typename T>
+struct tagPoolSlot {
+  tagPoolBody<T> body;
+  char pad[CB_COMMON_POOL_HPP_LEN_CACHELINE - sizeof(tagPoolBody<T>) % CB_COMMON_POOL_HPP_LEN_CACHELINE];
+};
+
+// free stack of a shard: tag << 32 | top slot
+struct tagPoolShard {
+  std::atomic<unsigned long long> free;
+  char pad[CB_COMMON_POOL_HPP_LEN_CACHELINE - sizeof(std::atomic<unsigned long long>)];
 };
 
+// waiting get() or lease_async(), served first come first served
+struct tagPoolWaiter {
+  std::condition_variable cv;
+  int slot; // handed over by release(), -1 until then
+  bool cancelled; // clear()
+  std::function<void(int)> ready; // lease_async(): called with the slot instead of waking cv, -1 when cancelled
+};
+
+// free slots are kept on lock-free stacks of indices (tagged against ABA),
+// get() and release() take or put one in O(1) without a lock.
+// with several shards every thread takes from and returns to its own stack,
+// and steals from the others only when its own is empty.
+// the mutex is only for callers that have to wait, who are served in order.
+//
+// set() makes a fixed pool which connects nothing up front and refreshes stale resources in get().
+// configure() makes an elastic one: min resources connected in parallel, and a health thread that
+// builds more for the waiters up to max, reconnects broken / stale ones and drops those idle for too long.
 template <typename T> // class T : public IPoolResource
 class Pool {
+ public:
+  // a resource together with its slot, released when it goes out of scope
+  class Lease {
+   public:
+    Lease(void);
+    Lease(Lease&& rhs);
+    Lease& operator =(Lease&& rhs);
+    ~Lease(void);
+    Lease(const Lease& rhs) = delete;
+    Lease& operator =(const Lease& rhs) = delete;
+
+    T* get(void) const;
+    T* operator ->(void) const;
+    explicit operator bool(void) const;
+    void release(void);
+
+   private:
+    friend class Pool;
+    Lease(Pool* pool, unsigned int slot);
+
+   private:
+    Pool* m_pool;
+    unsigned int m_slot;
+  };
+
  public:
   Pool(void);
   ~Pool(void);
@@ -35,145 +164,869 @@ class Pool {
   Pool& operator =(const Pool& rhs) = delete;
   void* operator new (std::size_t) = delete;
 
-  void set(unsigned int n);
+  // shards: 0 gives one per hardware thread
+  void set(unsigned int n, unsigned int shards = 1);
+  // idle: sec an unused resource above min is kept (0: forever). init runs on every new resource before connect()
+  void configure(unsigned int min, unsigned int max, unsigned int idle, unsigned int shards = 1, std::function<void(T&)> init = nullptr);
+  // waits until a resource is released
   T* get(void);
+  // NULL when none was released within timeout
+  T* get_for(std::chrono::milliseconds timeout);
+  // NULL when every resource is in use, never builds one (nor wakes the health thread to)
+  T* try_get(void);
+  Lease lease(void);
+  Lease lease_for(std::chrono::milliseconds timeout);
+  // never blocks, nor connects: done gets the lease right away when a resource is free, or else later on the releasing
+  // (or health) thread with the pool locked, so it must only move the lease on (e.g. post it to an executor).
+  // an empty lease when cleared
+  void lease_async(std::function<void(Lease&)> done);
+  // hands rsc straight to the longest waiting get()
   void release(T* rsc);
   void clear(void);
+  // nsec get() waited for a resource
+  const Histogram& waits(void) const;
+  // nsec a resource was held, get() ~ release()
+  const Histogram& holds(void) const;
+  // also reports (once each) the leases held longer than the leak threshold
+  tagPoolStats stats(void);
+  void setLeakThreshold(std::chrono::milliseconds threshold);
+  // resources currently constructed
+  int size(void) const;
+
+ private:
+  typedef typename std::aligned_storage<sizeof(T), std::alignment_of<T>::value>::type tagStorage;
+
+  template <typename U>
+  static U* aligned(std::unique_ptr<char[]>& raw, std::size_t n);
+  void allocate(unsigned int n, unsigned int shards);
+  tagPoolShard& shard(void);
+  tagPoolBody<T>& body(unsigned int slot);
+  int acquire(bool wait, std::chrono::milliseconds timeout);
+  void take(int slot);
+  void put(unsigned int slot);
+  unsigned int pop(tagPoolShard& shard);
+  unsigned int popAny(void);
+  void push(tagPoolShard& shard, unsigned int slot);
+  void handoff(void);
+  void build(unsigned int slot);
+  unsigned int grow(void);
+  void shrink(unsigned int slot);
+  void wake(void);
+  void expand(void);
+  void check(void);
+  void leaks(std::vector<tagPoolLeak>& rtn);
+  void stopHealth(void);
 
  private:
   std::mutex m_mtx;
-  int m_size;
-  int m_wait;
+  std::atomic<int> m_size; // slots
+  std::atomic<int> m_live; // constructed resources
+  int m_min;
+  int m_idle;
+  bool m_elastic;
+  std::function<void(T&)> m_init;
   int m_timeout;
-  std::vector<tagPoolBody<T>> m_vec;
-  std::hash<T*> m_hash;
+  std::unique_ptr<tagStorage[]> m_storage; // the resources, release(T*) finds its slot from the address
+  std::unique_ptr<char[]> m_slots_raw;
+  tagPoolSlot<T>* m_slots;
+  std::unique_ptr<char[]> m_shards_raw;
+  tagPoolShard* m_shards;
+  unsigned int m_shards_size;
+  tagPoolShard m_empty; // slots without a resource
+  std::deque<tagPoolWaiter*> m_waiters; // m_mtx
+  std::atomic<unsigned int> m_waiting;
+  Histogram m_waits;
+  Histogram m_holds;
+  std::atomic<unsigned long long> m_timeouts;
+  std::atomic<unsigned long long> m_reconnects;
+  std::atomic<unsigned long long> m_leak; // nsec
+
+  std::unique_ptr<std::thread> m_health;
+  std::mutex m_health_mtx;
+  std::condition_variable m_health_cv;
+  bool m_health_stop; // m_health_mtx
+  bool m_health_grow; // m_health_mtx, someone waits while slots are empty
 };
 
+// ---------------------------------------------------- Pool<T>::Lease
+template <typename T>
+Pool<T>::Lease::Lease(void) : m_pool(NULL), m_slot(CB_COMMON_POOL_HPP_NIL) {
+}
+
+template <typename T>
+Pool<T>::Lease::Lease(Pool* pool, unsigned int slot) : m_pool(pool), m_slot(slot) {
+}
+
 template <typename T>
-Pool<T>::Pool(void) : m_size(0), m_wait(0), m_timeout(28800) {
+Pool<T>::Lease::Lease(Lease&& rhs) : m_pool(rhs.m_pool), m_slot(rhs.m_slot) {
+  rhs.m_pool = NULL;
+  rhs.m_slot = CB_COMMON_POOL_HPP_NIL;
+}
+
+template <typename T>
+typename Pool<T>::Lease& Pool<T>::Lease::operator =(Lease&& rhs) {
+  if (this != &rhs) {
+    release();
+    m_pool = rhs.m_pool;
+    m_slot = rhs.m_slot;
+    rhs.m_pool = NULL;
+    rhs.m_slot = CB_COMMON_POOL_HPP_NIL;
+  }
+
+  return *this;
+}
+
+template <typename T>
+Pool<T>::Lease::~Lease(void) {
+  release();
+}
+
+template <typename T>
+T* Pool<T>::Lease::get(void) const {
+  return (m_pool != NULL) ? m_pool->body(m_slot).body : NULL;
+}
+
+template <typename T>
+T* Pool<T>::Lease::operator ->(void) const {
+  return get();
+}
+
+template <typename T>
+Pool<T>::Lease::operator bool(void) const {
+  return (m_pool != NULL);
+}
+
+template <typename T>
+void Pool<T>::Lease::release(void) {
+  // nothing to give back once the pool was cleared
+  if (m_pool != NULL && m_pool->m_size.load() > 0) {
+    m_pool->put(m_slot);
+  }
+  if (m_pool != NULL) {
+    m_pool = NULL;
+    m_slot = CB_COMMON_POOL_HPP_NIL;
+  }
+}
+
+// ---------------------------------------------------- Pool<T>
+template <typename T>
+Pool<T>::Pool(void) :
+  m_size(0),
+  m_live(0),
+  m_min(0),
+  m_idle(0),
+  m_elastic(false),
+  m_timeout(28800),
+  m_slots(NULL),
+  m_shards(NULL),
+  m_shards_size(0),
+  m_waiting(0),
+  m_timeouts(0),
+  m_reconnects(0),
+  m_leak(static_cast<unsigned long long>(CB_COMMON_POOL_HPP_LEAK) * 1000000),
+  m_health_stop(false),
+  m_health_grow(false)
+{
+  m_empty.free.store(CB_COMMON_POOL_HPP_NIL);
 }
 
 template <typename T>
 Pool<T>::~Pool(void) {
+  stopHealth();
   //clear();
 }
 
+// m_mtx: slots, shards and storage, every slot empty
 template <typename T>
-void Pool<T>::set(unsigned int n) {
+void Pool<T>::allocate(unsigned int n, unsigned int shards) {
+  if (shards == 0) {
+    shards = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+  }
+  m_shards_size = std::max<unsigned int>(std::min(shards, n), 1);
+  m_shards = aligned<tagPoolShard>(m_shards_raw, m_shards_size);
+  for (unsigned int i = 0; i < m_shards_size; ++i) {
+    m_shards[i].free.store(CB_COMMON_POOL_HPP_NIL);
+  }
+
+  m_storage.reset(new tagStorage[n]);
+  m_slots = aligned<tagPoolSlot<T>>(m_slots_raw, n);
+  m_empty.free.store(CB_COMMON_POOL_HPP_NIL);
+  for (unsigned int s = n; s > 0; --s) {
+    tagPoolBody<T>& ps = body(s - 1);
+    ps.body = NULL;
+    ps.timeout = m_timeout;
+    ps.past = 0;
+    ps.checked = 0;
+    ps.live = false;
+    ps.connected = false;
+    ps.use.store(0);
+    ps.next.store(CB_COMMON_POOL_HPP_NIL);
+    ps.taken.store(0);
+    ps.owner.store(0);
+    ps.reported.store(false);
+    push(m_empty, s - 1);
+  }
+
+  m_waits.reset();
+  m_holds.reset();
+  m_timeouts.store(0);
+  m_reconnects.store(0);
+}
+
+// the slot is ours and empty: constructs its resource (connect() is up to the caller)
+template <typename T>
+void Pool<T>::build(unsigned int slot) {
+  tagPoolBody<T>& ps = body(slot);
+
+  ps.body = new (&m_storage[slot]) T();
+  if (m_init) {
+    m_init(*ps.body);
+  }
+  ps.past = static_cast<time_t>(times::unixtimecoarse());
+  ps.checked = ps.past;
+  ps.live = true;
+  ps.connected = false;
+  m_live.fetch_add(1);
+}
+
+template <typename T>
+void Pool<T>::set(unsigned int n, unsigned int shards) {
   short s = 0;
 
-  if (m_size == 0) {
+  if (m_size.load() == 0) {
     m_mtx.lock();
-    if (m_size == 0) {
-      m_size = n;
-      m_wait = 1;//m_size << 1;
-      m_vec.reserve(m_size);
-      for (s = 0; s < m_size; ++s) {
-        tagPoolBody<T> ps;
-        ps.body = new T();
+    if (m_size.load() == 0) {
+      allocate(n, shards);
+      for (s = 0; s < static_cast<int>(n); ++s) {
+        build(pop(m_empty));
         //ps.body->connect(); // not yet set the connection informations
-        ps.timeout = m_timeout;
-        ps.past = time(NULL);
-        ps.use = 0;
-        m_vec.push_back(ps);
 
-        cb::common::Logger::log(cb::common::Logger::eLevel::eInfo, "%s%hd", "Pool set #", (s + 1));
+        CB_LOG_INFO("%s%hd", "Pool set #", (s + 1));
+      }
+      // dealt round robin, lowest slot on top
+      for (s = static_cast<short>(n) - 1; s >= 0; --s) {
+        push(m_shards[s % m_shards_size], s);
       }
+      m_size.store(n);
     }
     m_mtx.unlock();
   }
 }
 
 template <typename T>
-T* Pool<T>::get(void) {
-  typename std::vector<tagPoolBody<T>>::iterator it = m_vec.begin();
+void Pool<T>::configure(unsigned int min, unsigned int max, unsigned int idle, unsigned int shards, std::function<void(T&)> init) {
+  max = std::max<unsigned int>(std::max(min, max), 1);
 
-  short s = 0;
-  T* rsc = NULL;
-  time_t past;
-
-  if (m_size > 0) {
-    past = time(NULL);
-    while (rsc == NULL) {
-      s = 0;
-      //printf("(%d / %d)\n", time(NULL) - past, m_wait);
-      for (auto it = m_vec.begin(); it != m_vec.end(); ++it) {
-        s++;
-        if (it->use == 0) {
-          m_mtx.lock();
-          if (it->use == 0) {
-            if (time(NULL) - it->past > it->timeout) {
-              cb::common::Logger::log(cb::common::Logger::eLevel::eDebug, "%s%hd%s%d%s%d%s", "Pool refresh #", s, " for timeout (", (time(NULL) - it->past), " / ", it->timeout, " sec)");
-              it->body->disconnect();
-              it->body->connect();
-            }
-            rsc = it->body;
-            it->past = time(NULL);
-            it->use = 1;
+  if (m_size.load() == 0) {
+    m_mtx.lock();
+    if (m_size.load() == 0) {
+      m_min = min;
+      m_idle = idle;
+      m_init = init;
+      m_elastic = true;
+      allocate(max, shards);
+      for (unsigned int s = 0; s < min; ++s) {
+        build(pop(m_empty));
+      }
 
-            cb::common::Logger::log(cb::common::Logger::eLevel::eInfo, "%s%hd", "Pool get #", s);
+      // prewarm in parallel, connect() mostly waits on the network
+      unsigned int workers = std::min<unsigned int>(min, CB_COMMON_POOL_HPP_LEN_PREWARM);
+      std::vector<std::thread> th;
+      for (unsigned int w = 0; w < workers; ++w) {
+        th.emplace_back([this, w, workers, min]() {
+          for (unsigned int s = w; s < min; s += workers) {
+            body(s).connected = body(s).body->connect();
           }
-          m_mtx.unlock();
+        });
+      }
+      for (auto it = th.begin(); it != th.end(); ++it) {
+        it->join();
+      }
+
+      for (unsigned int s = min; s > 0; --s) {
+        push(m_shards[(s - 1) % m_shards_size], s - 1);
+      }
+      m_size.store(max);
+      CB_LOG_INFO("%s%u%s%u%s", "Pool configured (", min, " ~ ", max, ")");
+
+      m_health_stop = false;
+      m_health_grow = false;
+      m_health.reset(new std::thread([this]() {
+        std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() + std::chrono::seconds(CB_COMMON_POOL_HPP_INTERVAL);
+        bool grow = false;
 
-          if (it->use == 1) {
-            break;
+        for (;;) {
+          {
+            std::unique_lock<std::mutex> lock(m_health_mtx);
+            m_health_cv.wait_until(lock, due, [this]() { return m_health_stop == true || m_health_grow == true; });
+            if (m_health_stop == true) {
+              break;
+            }
+            grow = m_health_grow;
+            m_health_grow = false;
+          }
+          if (grow == true) {
+            expand();
+          }
+          if (std::chrono::steady_clock::now() >= due) {
+            check();
+            due = std::chrono::steady_clock::now() + std::chrono::seconds(CB_COMMON_POOL_HPP_INTERVAL);
           }
         }
+      }));
+    }
+    m_mtx.unlock();
+  }
+}
+
+template <typename T>
+template <typename U>
+U* Pool<T>::aligned(std::unique_ptr<char[]>& raw, std::size_t n) {
+  raw.reset(new char[sizeof(U) * n + CB_COMMON_POOL_HPP_LEN_CACHELINE]);
+
+  std::uintptr_t p = reinterpret_cast<std::uintptr_t>(raw.get());
+  p = (p + CB_COMMON_POOL_HPP_LEN_CACHELINE - 1) & ~static_cast<std::uintptr_t>(CB_COMMON_POOL_HPP_LEN_CACHELINE - 1);
+
+  U* rtn = reinterpret_cast<U*>(p);
+  for (std::size_t i = 0; i < n; ++i) {
+    new (&rtn[i]) U();
+  }
+
+  return rtn;
+}
+
+template <typename T>
+tagPoolShard& Pool<T>::shard(void) {
+  // threads are dealt to the shards in the order they first come
+  static std::atomic<unsigned int> next(0);
+  static thread_local unsigned int id = next.fetch_add(1, std::memory_order_relaxed);
+
+  return m_shards[id % m_shards_size];
+}
+
+template <typename T>
+tagPoolBody<T>& Pool<T>::body(unsigned int slot) {
+  return m_slots[slot].body;
+}
+
+template <typename T>
+unsigned int Pool<T>::pop(tagPoolShard& shard) {
+  unsigned long long head = shard.free.load();
+  unsigned long long next;
+  unsigned int slot;
+
+  for (;;) {
+    slot = static_cast<unsigned int>(head & 0xffffffffULL);
+    if (slot == CB_COMMON_POOL_HPP_NIL) {
+      return slot;
+    }
+    next = ((head >> 32) + 1) << 32 | body(slot).next.load(std::memory_order_relaxed);
+    if (shard.free.compare_exchange_weak(head, next) == true) {
+      return slot;
+    }
+  }
+}
+
+// own shard first, then steal
+template <typename T>
+unsigned int Pool<T>::popAny(void) {
+  tagPoolShard& own = shard();
+  unsigned int slot = pop(own);
+  std::size_t first = &own - m_shards;
+
+  for (unsigned int i = 1; i < m_shards_size && slot == CB_COMMON_POOL_HPP_NIL; ++i) {
+    slot = pop(m_shards[(first + i) % m_shards_size]);
+  }
+
+  return slot;
+}
+
+template <typename T>
+void Pool<T>::push(tagPoolShard& shard, unsigned int slot) {
+  unsigned long long head = shard.free.load();
+  unsigned long long next;
+
+  do {
+    body(slot).next.store(static_cast<unsigned int>(head & 0xffffffffULL), std::memory_order_relaxed);
+    next = ((head >> 32) + 1) << 32 | slot;
+  } while (shard.free.compare_exchange_weak(head, next) == false);
+}
+
+// m_mtx: free slots go to the front waiters
+template <typename T>
+void Pool<T>::handoff(void) {
+  unsigned int slot;
+
+  while (m_waiters.empty() == false && (slot = popAny()) != CB_COMMON_POOL_HPP_NIL) {
+    tagPoolWaiter* waiter = m_waiters.front();
+    m_waiters.pop_front();
+    m_waiting.fetch_sub(1);
+    if (waiter->ready) {
+      std::unique_ptr<tagPoolWaiter> owned(waiter);
+      waiter->ready(static_cast<int>(slot));
+    } else {
+      waiter->slot = static_cast<int>(slot);
+      waiter->cv.notify_one();
+    }
+  }
+}
+
+// a new resource in an empty slot, connected on the caller's thread
+template <typename T>
+unsigned int Pool<T>::grow(void) {
+  unsigned int slot = pop(m_empty);
+
+  if (slot != CB_COMMON_POOL_HPP_NIL) {
+    build(slot);
+    body(slot).connected = body(slot).body->connect();
+
+    CB_LOG_INFO("%s%u%s%d%s", "Pool grow #", slot + 1, " (", m_live.load(), ")");
+  }
+
+  return slot;
+}
+
+// asks the health thread to grow, when there's an empty slot for it (only an elastic pool has any)
+template <typename T>
+void Pool<T>::wake(void) {
+  if (static_cast<unsigned int>(m_empty.free.load() & 0xffffffffULL) == CB_COMMON_POOL_HPP_NIL) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(m_health_mtx);
+  m_health_grow = true;
+  m_health_cv.notify_one();
+}
+
+// health thread: a resource per waiter while slots are empty, each handed over once connected
+template <typename T>
+void Pool<T>::expand(void) {
+  unsigned int slot;
+
+  while (m_waiting.load() > 0 && (slot = grow()) != CB_COMMON_POOL_HPP_NIL) {
+    push(shard(), slot);
+    std::lock_guard<std::mutex> guard(m_mtx);
+    handoff();
+  }
+}
+
+template <typename T>
+void Pool<T>::shrink(unsigned int slot) {
+  tagPoolBody<T>& ps = body(slot);
+
+  ps.body->disconnect();
+  ps.body->~T();
+  ps.body = NULL;
+  ps.live = false;
+  m_live.fetch_sub(1);
+  push(m_empty, slot);
+
+  CB_LOG_INFO("%s%u%s%d%s", "Pool shrink #", slot + 1, " (", m_live.load(), ")");
+}
+
+// health thread: takes the due resources off a shard's stack one at a time. the idle ones above a due one
+// are held only while the stack is walked down to it and go back before it's validated,
+// so that get() never waits on a reconnect
+template <typename T>
+void Pool<T>::check(void) {
+  time_t now = static_cast<time_t>(times::unixtimecoarse());
+  std::vector<unsigned int> held;
+  unsigned int slot;
+  // checked this round already: a failed reconnect waits for the next one
+  auto due = [this, now](const tagPoolBody<T>& ps) {
+    return ps.checked != now &&
+      ((m_idle > 0 && now - ps.past > m_idle && m_live.load() > m_min) ||
+      ps.connected == false || now - ps.past > ps.timeout || now - ps.checked >= CB_COMMON_POOL_HPP_VALIDATE);
+  };
+
+  for (unsigned int i = 0; i < m_shards_size; ++i) {
+    for (;;) {
+      held.clear();
+      while ((slot = pop(m_shards[i])) != CB_COMMON_POOL_HPP_NIL && due(body(slot)) == false) {
+        held.push_back(slot);
+      }
+      // back in the order they were
+      for (auto it = held.rbegin(); it != held.rend(); ++it) {
+        push(m_shards[i], *it);
+      }
+      if (held.empty() == false && m_waiting.load() > 0) {
+        std::lock_guard<std::mutex> guard(m_mtx);
+        handoff();
+      }
+      if (slot == CB_COMMON_POOL_HPP_NIL) {
+        break;
       }
 
-      if (rsc == NULL) {
-        int wait = 1;
-        if (time(NULL) - past > m_wait) {
-          wait = m_wait;
-          past = time(NULL);
-        }
-        cb::common::Logger::log(cb::common::Logger::eLevel::eDebug, "%s%d%s", " sleep ................................................. ", wait, " sec");
-        WAIT_A_SECONDS(wait);
+      tagPoolBody<T>& ps = body(slot);
+      if (m_idle > 0 && now - ps.past > m_idle && m_live.load() > m_min) {
+        shrink(slot);
+        continue;
       }
+      ps.checked = now;
+      if (ps.connected == false || now - ps.past > ps.timeout || ps.body->validate() == false) {
+        CB_LOG_DEBUG("%s%u%s%d%s", "Pool reconnect #", slot + 1, " (idle ", static_cast<int>(now - ps.past), " sec)");
+        m_reconnects.fetch_add(1, std::memory_order_relaxed);
+        ps.body->disconnect();
+        ps.connected = ps.body->connect();
+        ps.past = now;
+      }
+
+      push(m_shards[i], slot);
+      if (m_waiting.load() > 0) {
+        std::lock_guard<std::mutex> guard(m_mtx);
+        handoff();
+      }
+    }
+  }
+
+  // reported here, without anyone asking for stats()
+  std::vector<tagPoolLeak> overdue;
+  leaks(overdue);
+}
+
+template <typename T>
+void Pool<T>::stopHealth(void) {
+  if (m_health.get() == nullptr) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_health_mtx);
+    m_health_stop = true;
+    m_health_cv.notify_one();
+  }
+  m_health->join();
+  m_health.reset();
+}
+
+template <typename T>
+int Pool<T>::acquire(bool wait, std::chrono::milliseconds timeout) {
+  unsigned long long started = times::cycles();
+  unsigned int slot = CB_COMMON_POOL_HPP_NIL;
+
+  if (m_size.load() == 0) {
+    return -1;
+  }
+
+  // nobody may overtake the ones already waiting
+  if (m_waiting.load() == 0) {
+    slot = popAny();
+  }
+
+  if (slot == CB_COMMON_POOL_HPP_NIL && wait == true) {
+    std::unique_lock<std::mutex> lock(m_mtx);
+    tagPoolWaiter waiter;
+    waiter.slot = -1;
+    waiter.cancelled = false;
+    m_waiters.push_back(&waiter);
+    m_waiting.fetch_add(1);
+    // a release that didn't see us waiting left its slot on the stack
+    handoff();
+    // connecting a new one is up to the health thread, so the timeout holds while it does
+    if (waiter.slot < 0) {
+      wake();
     }
+
+    if (timeout == std::chrono::milliseconds::max()) {
+      waiter.cv.wait(lock, [&waiter]() { return waiter.slot >= 0 || waiter.cancelled == true; });
+    } else {
+      waiter.cv.wait_for(lock, timeout, [&waiter]() { return waiter.slot >= 0 || waiter.cancelled == true; });
+    }
+
+    if (waiter.slot >= 0) {
+      slot = static_cast<unsigned int>(waiter.slot);
+    } else if (waiter.cancelled == false) {
+      // timed out, nothing was handed over
+      m_waiters.erase(std::find(m_waiters.begin(), m_waiters.end(), &waiter));
+      m_waiting.fetch_sub(1);
+      m_timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (slot == CB_COMMON_POOL_HPP_NIL) {
+    return -1;
+  }
+
+  take(static_cast<int>(slot));
+  m_waits.record(times::cyclesToNanos(times::cycles() - started));
+
+  return static_cast<int>(slot);
+}
+
+// the slot is ours: a fixed pool reconnects it here when stale, an elastic one left that to check()
+template <typename T>
+void Pool<T>::take(int slot) {
+  tagPoolBody<T>& ps = body(slot);
+  time_t now = static_cast<time_t>(times::unixtimecoarse());
+  int elapsed = static_cast<int>(now - ps.past);
+
+  ps.past = now;
+  ps.use.store(1, std::memory_order_relaxed);
+  ps.owner.store(std::hash<std::thread::id>()(std::this_thread::get_id()), std::memory_order_relaxed);
+  ps.reported.store(false, std::memory_order_relaxed);
+
+  if (m_elastic == false && elapsed > ps.timeout) {
+    CB_LOG_DEBUG("%s%hd%s%d%s%d%s", "Pool refresh #", static_cast<short>(slot + 1), " for timeout (", elapsed, " / ", ps.timeout, " sec)");
+    m_reconnects.fetch_add(1, std::memory_order_relaxed);
+    ps.body->disconnect();
+    ps.body->connect();
   }
+  // held from here, after a reconnect
+  ps.taken.store(times::cycles(), std::memory_order_release);
+}
+
+template <typename T>
+void Pool<T>::put(unsigned int slot) {
+  short use = 1;
 
-  return rsc;
+  // twice, or never taken
+  if (body(slot).use.compare_exchange_strong(use, 0, std::memory_order_relaxed) == false) {
+    return;
+  }
+  m_holds.record(times::cyclesToNanos(times::cycles() - body(slot).taken.exchange(0, std::memory_order_relaxed)));
+  body(slot).past = static_cast<time_t>(times::unixtimecoarse());
+
+  push(shard(), slot);
+  if (m_waiting.load() > 0) {
+    std::lock_guard<std::mutex> guard(m_mtx);
+    handoff();
+  }
+}
+
+template <typename T>
+T* Pool<T>::get(void) {
+  int slot = acquire(true, std::chrono::milliseconds::max());
+
+  return (slot < 0) ? NULL : body(slot).body;
+}
+
+template <typename T>
+T* Pool<T>::get_for(std::chrono::milliseconds timeout) {
+  int slot = acquire(true, timeout);
+
+  return (slot < 0) ? NULL : body(slot).body;
+}
+
+template <typename T>
+T* Pool<T>::try_get(void) {
+  int slot = acquire(false, std::chrono::milliseconds::zero());
+
+  return (slot < 0) ? NULL : body(slot).body;
+}
+
+template <typename T>
+typename Pool<T>::Lease Pool<T>::lease(void) {
+  int slot = acquire(true, std::chrono::milliseconds::max());
+
+  return (slot < 0) ? Lease() : Lease(this, static_cast<unsigned int>(slot));
+}
+
+template <typename T>
+typename Pool<T>::Lease Pool<T>::lease_for(std::chrono::milliseconds timeout) {
+  int slot = acquire(true, timeout);
+
+  return (slot < 0) ? Lease() : Lease(this, static_cast<unsigned int>(slot));
+}
+
+template <typename T>
+void Pool<T>::lease_async(std::function<void(Lease&)> done) {
+  unsigned long long started = times::cycles();
+  unsigned int slot = CB_COMMON_POOL_HPP_NIL;
+
+  if (m_size.load() == 0) {
+    Lease lease;
+    done(lease);
+    return;
+  }
+
+  if (m_waiting.load() == 0) {
+    slot = popAny();
+  }
+  if (slot != CB_COMMON_POOL_HPP_NIL) {
+    take(static_cast<int>(slot));
+    m_waits.record(times::cyclesToNanos(times::cycles() - started));
+    Lease lease(this, slot);
+    done(lease);
+    return;
+  }
+
+  std::unique_ptr<tagPoolWaiter> waiter(new tagPoolWaiter);
+  waiter->slot = -1;
+  waiter->cancelled = false;
+  // m_mtx held
+  waiter->ready = [this, done, started](int handed) {
+    Lease lease;
+    if (handed < 0) {
+      done(lease);
+      return;
+    }
+
+    take(handed);
+    m_waits.record(times::cyclesToNanos(times::cycles() - started));
+    lease = Lease(this, static_cast<unsigned int>(handed));
+    done(lease);
+    if (lease.m_pool != NULL) {
+      // done kept out of it: releasing here would relock m_mtx, back on the stack for the next waiter
+      lease.m_pool = NULL;
+      body(handed).use.store(0, std::memory_order_relaxed);
+      body(handed).taken.store(0, std::memory_order_relaxed);
+      push(shard(), static_cast<unsigned int>(handed));
+    }
+  };
+
+  {
+    std::lock_guard<std::mutex> guard(m_mtx);
+    m_waiters.push_back(waiter.release());
+    m_waiting.fetch_add(1);
+    handoff();
+  }
+  // connecting a new one is up to the health thread, it comes through handoff() too
+  if (m_waiting.load() > 0) {
+    wake();
+  }
 }
 
 template <typename T>
 void Pool<T>::release(T* rsc) {
-  typename std::vector<tagPoolBody<T>>::iterator it = m_vec.begin();
+  int size = m_size.load();
 
-  short s = 0;
+  if (size == 0 || rsc == NULL) {
+    return;
+  }
 
-  if (m_size > 0) {
-    for (auto it = m_vec.begin(); it != m_vec.end(); ++it) {
-      s++;
-      if (it->use == 1 && m_hash(it->body) == m_hash(rsc)) {
-        it->use = 0;
+  // resources live in m_storage, in slot order
+  std::ptrdiff_t slot = reinterpret_cast<tagStorage*>(rsc) - &m_storage[0];
+  if (slot < 0 || slot >= size) {
+    return;
+  }
 
-        cb::common::Logger::log(cb::common::Logger::eLevel::eInfo, "%s%d", "Pool release #", s);
-        break;
+  put(static_cast<unsigned int>(slot));
+}
+
+template <typename T>
+const Histogram& Pool<T>::waits(void) const {
+  return m_waits;
+}
+
+template <typename T>
+const Histogram& Pool<T>::holds(void) const {
+  return m_holds;
+}
+
+// the slots in use longer than m_leak, each logged the first time it's seen
+template <typename T>
+void Pool<T>::leaks(std::vector<tagPoolLeak>& rtn) {
+  unsigned long long now = times::cycles(), taken;
+  int size = m_size.load();
+  tagPoolLeak leak;
+
+  for (int s = 0; s < size; ++s) {
+    tagPoolBody<T>& ps = body(s);
+    taken = ps.taken.load(std::memory_order_acquire);
+    if (taken == 0 || now < taken || times::cyclesToNanos(now - taken) < m_leak.load(std::memory_order_relaxed)) {
+      continue;
+    }
+
+    leak.slot = static_cast<unsigned int>(s);
+    leak.thread = ps.owner.load(std::memory_order_relaxed);
+    leak.held = times::cyclesToNanos(now - taken);
+    rtn.push_back(leak);
+    if (ps.reported.exchange(true, std::memory_order_relaxed) == false) {
+      CB_LOG_WARN("%s%d%s%llu%s%llx", "Pool #", s + 1, " held for ", leak.held / 1000000, " msec by thread 0x", leak.thread);
+    }
+  }
+}
+
+template <typename T>
+tagPoolStats Pool<T>::stats(void) {
+  tagPoolStats rtn;
+  int size = 0;
+
+  rtn.in_use = 0;
+  rtn.idle = 0;
+  {
+    // the slots stay allocated while we count
+    std::lock_guard<std::mutex> guard(m_mtx);
+    size = m_size.load();
+    for (int s = 0; s < size; ++s) {
+      if (body(s).use.load(std::memory_order_relaxed) != 0) {
+        ++rtn.in_use;
       }
     }
+    if (size > 0) {
+      leaks(rtn.leaks);
+    }
   }
+
+  rtn.size = size;
+  rtn.live = m_live.load();
+  rtn.idle = std::max(rtn.live - rtn.in_use, 0);
+  rtn.waiting = m_waiting.load();
+  rtn.acquired = m_waits.count();
+  rtn.timeouts = m_timeouts.load(std::memory_order_relaxed);
+  rtn.reconnects = m_reconnects.load(std::memory_order_relaxed);
+  rtn.wait_p50 = m_waits.percentile(50);
+  rtn.wait_p99 = m_waits.percentile(99);
+  rtn.wait_max = m_waits.max();
+  rtn.hold_p50 = m_holds.percentile(50);
+  rtn.hold_p99 = m_holds.percentile(99);
+  rtn.hold_max = m_holds.max();
+
+  return rtn;
 }
 
 template <typename T>
-void Pool<T>::clear(void) {
-  typename std::vector<tagPoolBody<T>>::iterator it = m_vec.begin();
+void Pool<T>::setLeakThreshold(std::chrono::milliseconds threshold) {
+  m_leak.store(static_cast<unsigned long long>(threshold.count()) * 1000000, std::memory_order_relaxed);
+}
 
-  short s = 0;
+template <typename T>
+int Pool<T>::size(void) const {
+  return m_live.load();
+}
+
+template <typename T>
+void Pool<T>::clear(void) {
+  int s = 0;
 
-  if (m_size > 0) {
+  if (m_size.load() > 0) {
+    stopHealth();
     m_mtx.lock();
-    if (m_size > 0) {
-      for (auto it = m_vec.begin(); it != m_vec.end(); ++it) {
-        s++;
-        it->body->disconnect();
-        delete it->body; // warning: deleting object of polymorphic class type ‘PoolMySQL’ which has non-virtual destructor might cause undefined behaviour [-Wdelete-non-virtual-dtor]
-        it->use = 0;
+    int size = m_size.load();
+    if (size > 0) {
+      m_size.store(0);
+      for (s = 0; s < size; ++s) {
+        if (body(s).live == false) {
+          continue;
+        }
+        body(s).body->disconnect();
+        body(s).body->~T();
+        body(s).live = false;
+        body(s).use.store(0);
+
+        CB_LOG_INFO("%s%d", "Pool delete #", (s + 1));
+      }
+      m_live.store(0);
+      m_elastic = false;
+      m_slots = NULL;
+      m_slots_raw.reset();
+      m_shards = NULL;
+      m_shards_raw.reset();
+      m_shards_size = 0;
+      m_storage.reset();
+      m_empty.free.store(CB_COMMON_POOL_HPP_NIL);
 
-        cb::common::Logger::log(cb::common::Logger::eLevel::eInfo, "%s%d", "Pool delete #", s);
+      for (auto it = m_waiters.begin(); it != m_waiters.end(); ++it) {
+        if ((*it)->ready) {
+          std::unique_ptr<tagPoolWaiter> owned(*it);
+          owned->ready(-1);
+          continue;
+        }
+        (*it)->cancelled = true;
+        (*it)->cv.notify_one();
       }
-      m_vec.clear();
-      m_size = m_vec.size();
+      m_waiters.clear();
+      m_waiting.store(0);
     }
     m_mtx.unlock();
   }
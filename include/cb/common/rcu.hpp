@@ -0,0 +1,116 @@
+#ifndef CB_COMMON_RCU_HPP_
+#define CB_COMMON_RCU_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define CB_COMMON_RCU_HPP_LEN_SLOTS 64 // reader counters, threads share them modulo
+#define CB_COMMON_RCU_HPP_LEN_CACHELINE 64
+
+namespace cb {
+namespace common {
+
+// read-copy-update: readers take the current T without a lock, publish() swaps in a new one and
+// deletes the old one once the readers that may still see it are done (sleepable RCU, two reader counters per slot).
+//   Rcu<Table> table(new Table);
+//   { Rcu<Table>::Guard t(table); t->find(...); } // t stays valid in the scope
+//   table.publish(new Table(...)); // blocks until the old one is free, never call it holding a Guard
+template <typename T>
+class Rcu {
+ private:
+  typedef struct {
+    std::atomic<unsigned long long> readers[2]; // by epoch parity
+    char pad[CB_COMMON_RCU_HPP_LEN_CACHELINE - 2 * sizeof(std::atomic<unsigned long long>)];
+  } tagSlot;
+
+ public:
+  class Guard {
+   public:
+    explicit Guard(const Rcu& rcu) :
+      m_slot(&rcu.slot()),
+      m_idx(rcu.m_epoch.load() & 1)
+    {
+      // counted before the pointer is read: publish() can't miss this reader
+      m_slot->readers[m_idx].fetch_add(1);
+      m_ptr = rcu.m_curr.load();
+    }
+    ~Guard(void) {
+      m_slot->readers[m_idx].fetch_sub(1, std::memory_order_release);
+    }
+    Guard(const Guard& rhs) = delete;
+    Guard& operator =(const Guard& rhs) = delete;
+
+    const T* get(void) const {
+      return m_ptr;
+    }
+    const T* operator ->(void) const {
+      return m_ptr;
+    }
+    const T& operator *(void) const {
+      return *m_ptr;
+    }
+
+   private:
+    tagSlot* m_slot;
+    unsigned int m_idx;
+    const T* m_ptr;
+  };
+
+  explicit Rcu(T* init = nullptr) : m_curr(init), m_epoch(0) {
+    for (unsigned int i = 0; i < CB_COMMON_RCU_HPP_LEN_SLOTS; ++i) {
+      m_slots[i].readers[0].store(0, std::memory_order_relaxed);
+      m_slots[i].readers[1].store(0, std::memory_order_relaxed);
+    }
+  }
+  ~Rcu(void) {
+    delete m_curr.load();
+  }
+  Rcu(const Rcu& rhs) = delete;
+  Rcu& operator =(const Rcu& rhs) = delete;
+
+  // next is owned from here on. returns once the previous T is deleted
+  void publish(T* next) {
+    std::lock_guard<std::mutex> guard(m_publish);
+    std::unique_ptr<T> prev(m_curr.exchange(next));
+
+    // a reader may have picked its counter just before the last flip: drain both
+    for (unsigned int i = 0; i < 2; ++i) {
+      unsigned int idx = m_epoch.fetch_add(1) & 1;
+      while (readers(idx) > 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+  }
+
+ private:
+  tagSlot& slot(void) const {
+    static std::atomic<unsigned int> next(0);
+    static thread_local unsigned int id = next.fetch_add(1, std::memory_order_relaxed);
+
+    return m_slots[id % CB_COMMON_RCU_HPP_LEN_SLOTS];
+  }
+
+  unsigned long long readers(unsigned int idx) const {
+    unsigned long long rtn = 0;
+
+    for (unsigned int i = 0; i < CB_COMMON_RCU_HPP_LEN_SLOTS; ++i) {
+      rtn += m_slots[i].readers[idx].load();
+    }
+
+    return rtn;
+  }
+
+ private:
+  std::atomic<T*> m_curr;
+  std::atomic<unsigned int> m_epoch;
+  mutable tagSlot m_slots[CB_COMMON_RCU_HPP_LEN_SLOTS];
+  std::mutex m_publish;
+};
+
+} // namespace common
+} // namespace cb
+
+#endif
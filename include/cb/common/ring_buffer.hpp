@@ -0,0 +1,149 @@
+#ifndef CB_COMMON_RING_BUFFER_HPP_
+#define CB_COMMON_RING_BUFFER_HPP_
+
+#include <cstddef>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#define CB_COMMON_RING_BUFFER_HPP_LEN_CACHELINE 64
+
+namespace cb {
+namespace common {
+
+// bounded multi-producer / multi-consumer queue
+// @reference http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+template <typename T>
+class RingBuffer {
+ public:
+  explicit RingBuffer(std::size_t capacity);
+  ~RingBuffer(void);
+  RingBuffer(const RingBuffer& rhs) = delete;
+  RingBuffer& operator =(const RingBuffer& rhs) = delete;
+
+  bool push(const T& v);
+  bool push(T&& v);
+  bool pop(T& v);
+
+  std::size_t capacity(void) const;
+  std::size_t size(void) const; // approximate under contention
+
+ private:
+  struct tagCell {
+    std::atomic<std::size_t> seq;
+    T data;
+  };
+
+  template <typename U>
+  bool emplace(U&& v);
+
+ private:
+  // padded so that producers and consumers don't share a cache line
+  std::size_t m_mask;
+  std::unique_ptr<tagCell[]> m_cells;
+  char m_pad0[CB_COMMON_RING_BUFFER_HPP_LEN_CACHELINE];
+  std::atomic<std::size_t> m_tail; // producers
+  char m_pad1[CB_COMMON_RING_BUFFER_HPP_LEN_CACHELINE - sizeof(std::atomic<std::size_t>)];
+  std::atomic<std::size_t> m_head; // consumers
+  char m_pad2[CB_COMMON_RING_BUFFER_HPP_LEN_CACHELINE - sizeof(std::atomic<std::size_t>)];
+};
+
+template <typename T>
+RingBuffer<T>::RingBuffer(std::size_t capacity) : m_mask(0), m_tail(0), m_head(0) {
+  std::size_t n = 2;
+  while (n < capacity) {
+    n <<= 1;
+  }
+  m_mask = n - 1;
+  m_cells.reset(new tagCell[n]);
+  for (std::size_t i = 0; i < n; ++i) {
+    m_cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+}
+
+template <typename T>
+RingBuffer<T>::~RingBuffer(void) {
+}
+
+template <typename T>
+template <typename U>
+bool RingBuffer<T>::emplace(U&& v) {
+  tagCell* cell;
+  std::size_t pos = m_tail.load(std::memory_order_relaxed);
+
+  for (;;) {
+    cell = &m_cells[pos & m_mask];
+    std::size_t seq = cell->seq.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+    if (diff == 0) {
+      if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // full
+      return false;
+    } else {
+      pos = m_tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  cell->data = std::forward<U>(v);
+  cell->seq.store(pos + 1, std::memory_order_release);
+
+  return true;
+}
+
+template <typename T>
+bool RingBuffer<T>::push(const T& v) {
+  return emplace(v);
+}
+
+template <typename T>
+bool RingBuffer<T>::push(T&& v) {
+  return emplace(std::move(v));
+}
+
+template <typename T>
+bool RingBuffer<T>::pop(T& v) {
+  tagCell* cell;
+  std::size_t pos = m_head.load(std::memory_order_relaxed);
+
+  for (;;) {
+    cell = &m_cells[pos & m_mask];
+    std::size_t seq = cell->seq.load(std::memory_order_acquire);
+    std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+    if (diff == 0) {
+      if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      // empty
+      return false;
+    } else {
+      pos = m_head.load(std::memory_order_relaxed);
+    }
+  }
+
+  v = std::move(cell->data);
+  cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+
+  return true;
+}
+
+template <typename T>
+std::size_t RingBuffer<T>::capacity(void) const {
+  return m_mask + 1;
+}
+
+template <typename T>
+std::size_t RingBuffer<T>::size(void) const {
+  std::size_t tail = m_tail.load(std::memory_order_relaxed);
+  std::size_t head = m_head.load(std::memory_order_relaxed);
+
+  return (tail > head) ? (tail - head) : 0;
+}
+
+} // namespace common
+} // namespace cb
+
+#endif
@@ -3,6 +3,11 @@
 #include <cstdio>
 #include <cstring>
 #include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 #if ((defined(_WIN32) || defined(_WIN64)) && !defined(__CYGWIN__) && !defined(__MINGW32__) && !defined(__MINGW64__))
 # include <WinSock2.h>
@@ -50,6 +55,16 @@ int gettimeofday(struct timeval *tp, struct timezone *tzp) {
 # include <sys/time.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+# if defined(_MSC_VER)
+#   include <intrin.h>
+# else
+#   include <x86intrin.h>
+#   include <cpuid.h>
+# endif
+# define CB_COMMON_TIMES_TSC
+#endif
+
 #include "include/cb/common/times.h"
 
 namespace cb {
@@ -78,7 +93,11 @@ unsigned long long unixtimemilli() {
 }
 
 struct tm* iso8601(char *timeexpr, unsigned long long utmilli) {
-  struct tm *rtn;
+  // per thread, sinks format their lines concurrently
+  static thread_local struct tm tm_rtn;
+  static thread_local time_t cached = -1;
+  static thread_local char cachedexpr[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
+  static thread_local std::size_t cachedlen = 0;
 
   //char timeexpr[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
 
@@ -92,12 +111,300 @@ struct tm* iso8601(char *timeexpr, unsigned long long utmilli) {
   }
 
   time_t rawtime = tv.tv_sec; //time(NULL);
-  rtn = gmtime(&rawtime); //rtn = localtime(&rawtime);
+  if (rawtime != cached) {
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+    gmtime_s(&tm_rtn, &rawtime);
+#else
+    gmtime_r(&rawtime, &tm_rtn); //rtn = localtime(&rawtime);
+#endif
+    cachedlen = strftime(cachedexpr, CB_DEFINES_H_LEN_ISO8601, "%Y-%m-%dT%H:%M:%S", &tm_rtn);
+    cached = rawtime;
+  }
 
-  strftime(timeexpr, CB_DEFINES_H_LEN_ISO8601, "%Y-%m-%dT%H:%M:%S", rtn);
-  sprintf(&timeexpr[strlen(timeexpr)], ".%03ldZ", tv.tv_usec / 1000);
+  memcpy(timeexpr, cachedexpr, cachedlen);
+  snprintf(&timeexpr[cachedlen], CB_DEFINES_H_LEN_ISO8601 - cachedlen, ".%03ldZ", static_cast<long>(tv.tv_usec / 1000));
 
-  return rtn;
+  return &tm_rtn;
+}
+
+void httpdate(char* timeexpr, unsigned long unixtime) {
+  // strftime's %a / %b follow the locale
+  static const char* const days[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+  static const char* const months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+  static thread_local time_t cached = -1;
+  static thread_local char cachedexpr[CB_DEFINES_H_LEN_HTTPDATE] = { '\0' };
+
+  time_t rawtime = static_cast<time_t>(unixtime);
+  if (rawtime != cached) {
+    struct tm tm_rec;
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+    gmtime_s(&tm_rec, &rawtime);
+#else
+    gmtime_r(&rawtime, &tm_rec);
+#endif
+    // clamped to the widths the buffer is sized for (29 + '\0'), the year to 4 digits
+    snprintf(cachedexpr, CB_DEFINES_H_LEN_HTTPDATE, "%s, %02u %s %04u %02u:%02u:%02u GMT",
+      days[static_cast<unsigned int>(tm_rec.tm_wday) % 7], static_cast<unsigned int>(tm_rec.tm_mday) % 100,
+      months[static_cast<unsigned int>(tm_rec.tm_mon) % 12], static_cast<unsigned int>(tm_rec.tm_year + 1900) % 10000,
+      static_cast<unsigned int>(tm_rec.tm_hour) % 100, static_cast<unsigned int>(tm_rec.tm_min) % 100, static_cast<unsigned int>(tm_rec.tm_sec) % 100);
+    cached = rawtime;
+  }
+
+  memcpy(timeexpr, cachedexpr, CB_DEFINES_H_LEN_HTTPDATE);
+}
+
+// ---------------------------------------------------- coarse clock
+namespace {
+
+// strings are published as words so that readers never race with the ticker (seqlock)
+static const std::size_t LEN_WORDS = 4;
+
+std::atomic<bool> clock_running(false);
+std::atomic<unsigned long long> clock_utmilli(0);
+std::atomic<unsigned int> clock_seq(0);
+std::atomic<unsigned long long> clock_iso8601[LEN_WORDS];
+std::atomic<unsigned long long> clock_httpdate[LEN_WORDS];
+
+std::mutex clock_mtx;
+unsigned int clock_users = 0; // clock_mtx
+std::atomic<bool> clock_stop(false);
+std::thread* clock_thread = NULL; // clock_mtx
+
+void storeWords(std::atomic<unsigned long long>* words, const char* expr, std::size_t len) {
+  unsigned long long tmp[LEN_WORDS] = { 0 };
+
+  memcpy(tmp, expr, std::min(len, sizeof(tmp) - 1));
+  for (std::size_t i = 0; i < LEN_WORDS; ++i) {
+    words[i].store(tmp[i], std::memory_order_relaxed);
+  }
+}
+
+void loadWords(const std::atomic<unsigned long long>* words, char* expr, std::size_t len) {
+  unsigned long long tmp[LEN_WORDS];
+
+  for (std::size_t i = 0; i < LEN_WORDS; ++i) {
+    tmp[i] = words[i].load(std::memory_order_relaxed);
+  }
+  memcpy(expr, tmp, len);
+}
+
+void tick(void) {
+  char isoexpr[CB_DEFINES_H_LEN_ISO8601] = { '\0' };
+  char httpexpr[CB_DEFINES_H_LEN_HTTPDATE] = { '\0' };
+  unsigned long long utmilli = unixtimemilli();
+  unsigned int seq = clock_seq.load(std::memory_order_relaxed);
+
+  iso8601(isoexpr, utmilli);
+  httpdate(httpexpr, static_cast<unsigned long>(utmilli / 1000000));
+
+  clock_seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  storeWords(clock_iso8601, isoexpr, CB_DEFINES_H_LEN_ISO8601);
+  storeWords(clock_httpdate, httpexpr, CB_DEFINES_H_LEN_HTTPDATE);
+  clock_seq.store(seq + 2, std::memory_order_release);
+  clock_utmilli.store(utmilli, std::memory_order_release);
+}
+
+void readWords(const std::atomic<unsigned long long>* words, char* expr, std::size_t len) {
+  unsigned int seq;
+
+  for (;;) {
+    seq = clock_seq.load(std::memory_order_acquire);
+    if ((seq & 1) == 0) {
+      loadWords(words, expr, len);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (clock_seq.load(std::memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+    std::this_thread::yield();
+  }
+  expr[len - 1] = '\0';
+}
+
+// a running ticker is stopped after every other static object is gone
+struct tagClockExit {
+  ~tagClockExit(void) {
+    std::lock_guard<std::mutex> guard(clock_mtx);
+
+    clock_running.store(false);
+    if (clock_thread != NULL) {
+      clock_stop.store(true);
+      clock_thread->join();
+      delete clock_thread;
+      clock_thread = NULL;
+    }
+  }
+} clock_exit;
+
+} // namespace
+
+bool startClock(unsigned int resolution) {
+  std::lock_guard<std::mutex> guard(clock_mtx);
+
+  if (clock_users++ > 0) {
+    return false;
+  }
+
+  tick();
+  clock_stop.store(false);
+  clock_running.store(true);
+  clock_thread = new std::thread([resolution]() {
+    while (clock_stop.load() == false) {
+      std::this_thread::sleep_for(std::chrono::microseconds(resolution));
+      tick();
+    }
+  });
+
+  return true;
+}
+
+void stopClock() {
+  std::thread* th = NULL;
+
+  {
+    std::lock_guard<std::mutex> guard(clock_mtx);
+
+    if (clock_users == 0 || --clock_users > 0) {
+      return;
+    }
+    clock_running.store(false);
+    clock_stop.store(true);
+    th = clock_thread;
+    clock_thread = NULL;
+  }
+
+  if (th != NULL) {
+    th->join();
+    delete th;
+  }
+}
+
+unsigned long unixtimecoarse() {
+  if (clock_running.load(std::memory_order_acquire) == false) {
+    return unixtime();
+  }
+
+  return static_cast<unsigned long>(clock_utmilli.load(std::memory_order_acquire) / 1000000);
+}
+
+unsigned long long unixtimemillicoarse() {
+  if (clock_running.load(std::memory_order_acquire) == false) {
+    return unixtimemilli();
+  }
+
+  return clock_utmilli.load(std::memory_order_acquire);
+}
+
+void iso8601coarse(char* timeexpr) {
+  if (clock_running.load(std::memory_order_acquire) == false) {
+    iso8601(timeexpr, 0);
+    return;
+  }
+
+  readWords(clock_iso8601, timeexpr, CB_DEFINES_H_LEN_ISO8601);
+}
+
+void httpdatecoarse(char* timeexpr) {
+  if (clock_running.load(std::memory_order_acquire) == false) {
+    httpdate(timeexpr, unixtime());
+    return;
+  }
+
+  readWords(clock_httpdate, timeexpr, CB_DEFINES_H_LEN_HTTPDATE);
+}
+
+// ---------------------------------------------------- monotonic
+namespace {
+
+std::atomic<bool> tsc_calibrated(false);
+std::atomic<unsigned long long> tsc_mult(0); // nsec per cycle << 32
+
+#ifdef CB_COMMON_TIMES_TSC
+bool tscInvariant(void) {
+# if defined(_MSC_VER)
+  int regs[4];
+  __cpuid(regs, 0x80000000);
+  if (static_cast<unsigned int>(regs[0]) < 0x80000007) {
+    return false;
+  }
+  __cpuid(regs, 0x80000007);
+  return (regs[3] & (1 << 8)) != 0;
+# else
+  unsigned int eax, ebx, ecx, edx;
+  if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+    return false;
+  }
+  return (edx & (1 << 8)) != 0;
+# endif
+}
+#endif
+
+} // namespace
+
+unsigned long long monotonic() {
+#if ((defined(_WIN32) || defined(_WIN64)) && !defined(__CYGWIN__) && !defined(__MINGW32__) && !defined(__MINGW64__))
+  static LARGE_INTEGER frequency = { 0 };
+  LARGE_INTEGER counter;
+
+  if (frequency.QuadPart == 0) {
+    QueryPerformanceFrequency(&frequency);
+  }
+  QueryPerformanceCounter(&counter);
+
+  return static_cast<unsigned long long>(counter.QuadPart / frequency.QuadPart) * 1000000000ULL +
+         static_cast<unsigned long long>(counter.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return static_cast<unsigned long long>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+unsigned long long cycles() {
+#ifdef CB_COMMON_TIMES_TSC
+  if (tsc_calibrated.load(std::memory_order_relaxed) == true) {
+    return __rdtsc();
+  }
+#endif
+
+  return monotonic();
+}
+
+bool calibrate(unsigned int msec) {
+#ifdef CB_COMMON_TIMES_TSC
+  if (tscInvariant() == false) {
+    return false;
+  }
+
+  unsigned long long ns0 = monotonic();
+  unsigned long long tsc0 = __rdtsc();
+  std::this_thread::sleep_for(std::chrono::milliseconds(msec));
+  unsigned long long ns1 = monotonic();
+  unsigned long long tsc1 = __rdtsc();
+
+  if (tsc1 <= tsc0 || ns1 <= ns0) {
+    return false;
+  }
+  tsc_mult.store(static_cast<unsigned long long>(static_cast<long double>(ns1 - ns0) / (tsc1 - tsc0) * 4294967296.0L));
+  tsc_calibrated.store(true);
+
+  return true;
+#else
+  (void)msec;
+  return false;
+#endif
+}
+
+unsigned long long cyclesToNanos(unsigned long long cycles) {
+  if (tsc_calibrated.load(std::memory_order_relaxed) == false) {
+    return cycles;
+  }
+
+  unsigned long long mult = tsc_mult.load(std::memory_order_relaxed);
+
+  return (cycles >> 32) * mult + (((cycles & 0xffffffffULL) * mult) >> 32);
 }
 
 } // namespace times
@@ -3,6 +3,8 @@
 
 #include "include/cb/common/defines.h"
 
+#define CB_COMMON_TIMES_H_RESOLUTION 1000 // usec
+
 namespace cb {
 namespace common {
 
@@ -10,7 +12,28 @@ namespace times {
 
 unsigned long unixtime();
 unsigned long long unixtimemilli();
+// the returned tm is per thread. the date part is rendered once per second per thread
 struct tm* iso8601(char* timeexpr, unsigned long long utmilli);
+// RFC 7231 IMF-fixdate, always in English
+void httpdate(char* timeexpr, unsigned long unixtime);
+
+// coarse clock: a ticker thread publishes the time (and both strings) every resolution usec,
+// readers get it with an atomic load instead of a system call.
+// start / stop nest. while nobody started it the coarse calls fall back to the ones above.
+bool startClock(unsigned int resolution = CB_COMMON_TIMES_H_RESOLUTION);
+void stopClock();
+unsigned long unixtimecoarse();
+unsigned long long unixtimemillicoarse();
+void iso8601coarse(char* timeexpr);
+void httpdatecoarse(char* timeexpr);
+
+// monotonic clock in nsec, for durations only (unaffected by wall-clock adjustments)
+unsigned long long monotonic();
+// cheapest timestamp available: the TSC once calibrate() found it invariant, monotonic() otherwise.
+// calibrate at startup, before any cycles() is taken
+unsigned long long cycles();
+bool calibrate(unsigned int msec = 10);
+unsigned long long cyclesToNanos(unsigned long long cycles);
 
 } // namespace times
 
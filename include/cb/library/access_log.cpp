@@ -0,0 +1,155 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <algorithm>
+#include <chrono>
+
+#include "include/cb/library/access_log.h"
+
+namespace {
+
+void appendEscaped(std::string& line, const char* s, bool json) {
+  char hex[8];
+
+  for (; *s != '\0'; ++s) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      line.push_back('\\');
+      line.push_back(static_cast<char>(c));
+    } else if (c < 0x20 || c == 0x7f) {
+      snprintf(hex, sizeof(hex), (json == true) ? "\\u%04x" : "\\x%02x", c);
+      line.append(hex);
+    } else {
+      line.push_back(static_cast<char>(c));
+    }
+  }
+}
+
+} // namespace
+
+namespace cb {
+namespace library {
+
+AccessLog::AccessLog(const char* filename, eFormat format, unsigned int capacity) :
+  m_filename(filename),
+  m_format(format),
+  m_fp(NULL),
+  m_queue(capacity),
+  m_dropped(0)
+{
+  reopen();
+  m_writer.reset(new std::thread([this]() {
+    drain();
+  }));
+}
+
+AccessLog::~AccessLog(void) {
+  m_queue.stop();
+  m_writer->join();
+
+  if (m_fp != NULL) {
+    fclose(m_fp);
+  }
+}
+
+bool AccessLog::isOpen(void) {
+  std::lock_guard<std::mutex> guard(m_fp_mtx);
+
+  return (m_fp != NULL);
+}
+
+bool AccessLog::reopen(void) {
+  std::lock_guard<std::mutex> guard(m_fp_mtx);
+
+  if (m_fp != NULL) {
+    fclose(m_fp);
+  }
+  m_fp = fopen(m_filename.c_str(), "ab");
+
+  return (m_fp != NULL);
+}
+
+void AccessLog::log(const tagRecord& rec) {
+  if (m_queue.push(rec) == false) {
+    m_dropped.fetch_add(1);
+  }
+}
+
+unsigned long long AccessLog::dropped(void) const {
+  return m_dropped.load();
+}
+
+void AccessLog::assign(char* field, std::size_t size, const char* src, std::size_t len) {
+  len = std::min(len, size - 1);
+  memcpy(field, src, len);
+  field[len] = '\0';
+}
+
+void AccessLog::format(eFormat format, const tagRecord& rec, std::string& line) {
+  char tmp[128];
+  struct tm tm_rec;
+  time_t rawtime = static_cast<time_t>(rec.utmilli / 1000000);
+
+#if defined(_WIN32) || defined(_WIN64) || defined(__CYGWIN__)
+  gmtime_s(&tm_rec, &rawtime);
+#else
+  gmtime_r(&rawtime, &tm_rec);
+#endif
+
+  if (format == eFormat::eJson) {
+    strftime(tmp, sizeof(tmp), "{\"time\": \"%Y-%m-%dT%H:%M:%S", &tm_rec);
+    line.append(tmp);
+    snprintf(tmp, sizeof(tmp), ".%03uZ\", \"remote\": \"", static_cast<unsigned int>(rec.utmilli % 1000000 / 1000));
+    line.append(tmp);
+    appendEscaped(line, rec.remote, true);
+    snprintf(tmp, sizeof(tmp), "\", \"port\": %hu, \"method\": \"", rec.port);
+    line.append(tmp);
+    appendEscaped(line, rec.method, true);
+    line.append("\", \"path\": \"");
+    appendEscaped(line, rec.path, true);
+    snprintf(tmp, sizeof(tmp), "\", \"status\": %u, \"bytes_in\": %llu, \"bytes_out\": %llu", rec.status, rec.bytes_in, rec.bytes_out);
+    line.append(tmp);
+    snprintf(tmp, sizeof(tmp), ", \"usec\": {\"read\": %u, \"handle\": %u, \"write\": %u, \"total\": %u}}\n", rec.usec_read, rec.usec_handle, rec.usec_write, rec.usec_total);
+    line.append(tmp);
+  } else {
+    // host ident authuser [date] "request" status bytes
+    appendEscaped(line, (rec.remote[0] != '\0') ? rec.remote : "-", false);
+    strftime(tmp, sizeof(tmp), " - - [%d/%b/%Y:%H:%M:%S +0000] \"", &tm_rec);
+    line.append(tmp);
+    appendEscaped(line, rec.method, false);
+    line.push_back(' ');
+    appendEscaped(line, rec.path, false);
+    snprintf(tmp, sizeof(tmp), " HTTP/1.1\" %u %llu\n", rec.status, rec.bytes_out);
+    line.append(tmp);
+  }
+}
+
+void AccessLog::drain(void) {
+  std::unique_ptr<tagRecord> rec(new tagRecord);
+  std::string lines;
+
+  m_queue.consume([this, &rec, &lines](bool /*stop*/) -> unsigned int {
+    unsigned int n;
+
+    lines.clear();
+    for (n = 0; n < CB_LIBRARY_ACCESS_LOG_H_LEN_BATCH && m_queue.pop(*rec) == true; ++n) {
+      format(m_format, *rec, lines);
+    }
+    if (n > 0) {
+      std::lock_guard<std::mutex> guard(m_fp_mtx);
+      if (m_fp != NULL) {
+        fwrite(lines.data(), 1, lines.size(), m_fp);
+        fflush(m_fp);
+      }
+    }
+
+    return n;
+  }, []() {
+    return std::chrono::milliseconds(CB_LIBRARY_ACCESS_LOG_H_INTERVAL);
+  });
+}
+
+} // namespace library
+} // namespace cb
@@ -0,0 +1,84 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifndef CB_LIBRARY_ACCESS_LOG_H_
+#define CB_LIBRARY_ACCESS_LOG_H_
+
+#include <cstdio>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "include/cb/common/batch_queue.hpp"
+
+#define CB_LIBRARY_ACCESS_LOG_H_LEN_METHOD 16
+#define CB_LIBRARY_ACCESS_LOG_H_LEN_PATH 256
+#define CB_LIBRARY_ACCESS_LOG_H_LEN_REMOTE 48
+#define CB_LIBRARY_ACCESS_LOG_H_LEN_QUEUE 8192
+#define CB_LIBRARY_ACCESS_LOG_H_LEN_BATCH 256
+#define CB_LIBRARY_ACCESS_LOG_H_INTERVAL 100 // msec
+
+namespace cb {
+namespace library {
+
+// one line per request, apart from the general log.
+// request threads only copy a fixed-size record into a queue (dropped when it's full),
+// the writer thread formats and writes them a batch at a time.
+class AccessLog {
+ public:
+  enum class eFormat : unsigned short {
+    eCommon = 0, // NCSA Common Log Format
+    eJson,       // one JSON object per line, with the timings
+  };
+
+  typedef struct {
+    unsigned long long utmilli; // accepted at
+    char method[CB_LIBRARY_ACCESS_LOG_H_LEN_METHOD];
+    char path[CB_LIBRARY_ACCESS_LOG_H_LEN_PATH]; // without the query string
+    char remote[CB_LIBRARY_ACCESS_LOG_H_LEN_REMOTE];
+    unsigned short port;
+    unsigned int status;
+    unsigned long long bytes_in;
+    unsigned long long bytes_out;
+    // usec: accept ~ request read, ~ response ready, ~ response sent, accept ~ sent
+    unsigned int usec_read;
+    unsigned int usec_handle;
+    unsigned int usec_write;
+    unsigned int usec_total;
+  } tagRecord;
+
+ public:
+  AccessLog(const char* filename, eFormat format = eFormat::eCommon, unsigned int capacity = CB_LIBRARY_ACCESS_LOG_H_LEN_QUEUE);
+  ~AccessLog(void);
+  AccessLog(const AccessLog& rhs) = delete;
+  AccessLog& operator =(const AccessLog& rhs) = delete;
+
+  bool isOpen(void);
+  // reopens the file, e.g. after logrotate moved it
+  bool reopen(void);
+  void log(const tagRecord& rec);
+  unsigned long long dropped(void) const;
+
+  // copies a string field, truncating it
+  static void assign(char* field, std::size_t size, const char* src, std::size_t len);
+  static void format(eFormat format, const tagRecord& rec, std::string& line);
+
+ private:
+  void drain(void);
+
+ private:
+  std::string m_filename;
+  eFormat m_format;
+  std::mutex m_fp_mtx;
+  FILE* m_fp; // m_fp_mtx
+
+  cb::common::BatchQueue<tagRecord> m_queue;
+  std::atomic<unsigned long long> m_dropped;
+  std::unique_ptr<std::thread> m_writer;
+};
+
+} // namespace library
+} // namespace cb
+
+#endif
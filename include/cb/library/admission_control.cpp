@@ -0,0 +1,194 @@
+#include <cmath>
+#include <algorithm>
+#include <functional>
+
+#include "include/cb/common/times.h"
+#include "include/cb/library/admission_control.h"
+
+namespace cb {
+namespace library {
+
+AdmissionControl::AdmissionControl(unsigned int concurrency, double rate, double burst, unsigned int target, unsigned int interval) :
+  m_concurrency(concurrency),
+  m_rate(std::max(rate, 0.0) / 1000000000.0),
+  m_burst(std::max(burst, 1.0)),
+  m_target(static_cast<unsigned long long>(target) * 1000ULL),
+  m_interval(static_cast<unsigned long long>(std::max(interval, target)) * 1000ULL),
+  m_inflight(0),
+  m_above(0),
+  m_stopped(0),
+  m_count(0),
+  m_shedding(false),
+  m_admitted(0),
+  m_busy(0),
+  m_route_busy(0),
+  m_limited(0),
+  m_shed(0)
+{
+  for (unsigned int i = 0; i < CB_LIBRARY_ADMISSION_CONTROL_H_LEN_SHARDS; ++i) {
+    m_shards.emplace_back(new tagShard);
+  }
+}
+
+AdmissionControl::~AdmissionControl(void) {
+}
+
+void AdmissionControl::limit(std::uintptr_t route, unsigned int concurrency) {
+  std::unique_ptr<tagRoute>& r = m_routes[route];
+
+  if (r.get() == nullptr) {
+    r.reset(new tagRoute);
+    r->inflight.store(0);
+  }
+  r->limit = concurrency;
+}
+
+AdmissionControl::eVerdict AdmissionControl::admit(const std::string& client, unsigned long long sojourn) {
+  unsigned long long now = ::cb::common::times::monotonic();
+
+  // cheapest first: the ones refused under overload cost the least
+  if (shed(now, sojourn) == true) {
+    return eVerdict::eShed;
+  }
+  if (take(client, now) == false) {
+    m_limited.fetch_add(1, std::memory_order_relaxed);
+    return eVerdict::eLimited;
+  }
+  if (m_inflight.fetch_add(1) >= m_concurrency && m_concurrency > 0) {
+    m_inflight.fetch_sub(1);
+    m_busy.fetch_add(1, std::memory_order_relaxed);
+    return eVerdict::eBusy;
+  }
+  m_admitted.fetch_add(1, std::memory_order_relaxed);
+
+  return eVerdict::eAdmit;
+}
+
+void AdmissionControl::release(void) {
+  m_inflight.fetch_sub(1);
+}
+
+bool AdmissionControl::enter(std::uintptr_t route, std::atomic<unsigned int>*& slot) {
+  slot = NULL;
+  if (m_routes.empty() == true) {
+    return true;
+  }
+
+  auto it = m_routes.find(route);
+  if (it == m_routes.end()) {
+    return true;
+  }
+  if (it->second->inflight.fetch_add(1) >= it->second->limit) {
+    it->second->inflight.fetch_sub(1);
+    m_route_busy.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  slot = &it->second->inflight;
+
+  return true;
+}
+
+void AdmissionControl::leave(std::atomic<unsigned int>* slot) {
+  if (slot != NULL) {
+    slot->fetch_sub(1);
+  }
+}
+
+bool AdmissionControl::shed(unsigned long long sojourn) {
+  return shed(::cb::common::times::monotonic(), sojourn);
+}
+
+bool AdmissionControl::shed(unsigned long long now, unsigned long long sojourn) {
+  if (m_target == 0) {
+    return false;
+  }
+
+  if (sojourn < m_target) {
+    // the queue drained: shedding stops
+    if (m_above.load(std::memory_order_relaxed) != 0) {
+      m_above.store(0, std::memory_order_relaxed);
+    }
+    if (m_shedding.load(std::memory_order_relaxed) == true && m_shedding.exchange(false) == true) {
+      m_stopped.store(now, std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+  if (m_shedding.load(std::memory_order_relaxed) == false) {
+    unsigned long long above = m_above.load(std::memory_order_relaxed);
+    unsigned long long stopped = m_stopped.load(std::memory_order_relaxed);
+    unsigned int count = 1;
+
+    if (above == 0) {
+      m_above.compare_exchange_strong(above, now, std::memory_order_relaxed);
+      return false;
+    }
+    // over target again soon after shedding stopped: it starts sooner each time (interval / sqrt(count))
+    if (stopped != 0 && now > stopped && now - stopped < 16 * m_interval) {
+      count = std::min<unsigned int>(m_count.load(std::memory_order_relaxed) + 1, 64);
+    }
+    if (now <= above || now - above < static_cast<unsigned long long>(m_interval / std::sqrt(static_cast<double>(count)))) {
+      return false;
+    }
+    if (m_shedding.exchange(true) == false) {
+      m_count.store(count, std::memory_order_relaxed);
+    }
+  }
+  m_shed.fetch_add(1, std::memory_order_relaxed);
+
+  return true;
+}
+
+bool AdmissionControl::take(const std::string& client, unsigned long long now) {
+  if (m_rate <= 0) {
+    return true;
+  }
+
+  tagShard& s = *m_shards[std::hash<std::string>()(client) % m_shards.size()];
+  std::lock_guard<std::mutex> guard(s.mtx);
+  auto it = s.buckets.find(client);
+  // now was read before the lock, another thread may have refilled later
+  auto elapsed = [now](const tagBucket& b) {
+    return static_cast<double>((now > b.refilled) ? now - b.refilled : 0);
+  };
+
+  if (it == s.buckets.end()) {
+    // the least recently seen makes room, back to a full bucket should it come again
+    if (s.buckets.size() >= CB_LIBRARY_ADMISSION_CONTROL_H_LEN_CLIENTS) {
+      s.buckets.erase(*s.lru.back());
+      s.lru.pop_back();
+    }
+    it = s.buckets.emplace(client, tagBucket()).first;
+    it->second.tokens = m_burst;
+    it->second.refilled = now;
+    s.lru.push_front(&it->first);
+    it->second.lru = s.lru.begin();
+  } else {
+    it->second.tokens = std::min(m_burst, it->second.tokens + elapsed(it->second) * m_rate);
+    s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+  }
+  it->second.refilled = std::max(it->second.refilled, now);
+
+  if (it->second.tokens < 1.0) {
+    return false;
+  }
+  it->second.tokens -= 1.0;
+
+  return true;
+}
+
+AdmissionControl::tagStats AdmissionControl::stats(void) const {
+  tagStats rtn;
+
+  rtn.admitted = m_admitted.load(std::memory_order_relaxed);
+  rtn.busy = m_busy.load(std::memory_order_relaxed);
+  rtn.route_busy = m_route_busy.load(std::memory_order_relaxed);
+  rtn.limited = m_limited.load(std::memory_order_relaxed);
+  rtn.shed = m_shed.load(std::memory_order_relaxed);
+  rtn.inflight = m_inflight.load(std::memory_order_relaxed);
+
+  return rtn;
+}
+
+} // namespace library
+} // namespace cb
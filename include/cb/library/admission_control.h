@@ -0,0 +1,126 @@
+#ifndef CB_LIBRARY_ADMISSION_CONTROL_H_
+#define CB_LIBRARY_ADMISSION_CONTROL_H_
+
+#include <cstdint>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define CB_LIBRARY_ADMISSION_CONTROL_H_TARGET 5000 // usec
+#define CB_LIBRARY_ADMISSION_CONTROL_H_INTERVAL 100000 // usec
+#define CB_LIBRARY_ADMISSION_CONTROL_H_LEN_SHARDS 16 // client buckets
+#define CB_LIBRARY_ADMISSION_CONTROL_H_LEN_CLIENTS 4096 // buckets per shard, the least recently seen client's goes first
+
+namespace cb {
+namespace library {
+
+// decides, before a request is routed, whether it's served or refused right away:
+// - concurrency: requests in flight at once (admitted ~ response sent), then per route
+// - rate: a token bucket per client address, refilled rate per sec up to burst
+// - queueing delay (CoDel): once every request waited longer than target for a whole interval,
+//   those waiting longer than target are shed until one gets through under it.
+//   shedding again soon after takes less than an interval, as CoDel's count does
+// a refusal touches a few atomics (a shard lock for the rate), nothing else.
+class AdmissionControl {
+ public:
+  enum class eVerdict : unsigned short {
+    eAdmit = 0,
+    eBusy,    // concurrency, 503
+    eLimited, // the client's rate, 429
+    eShed,    // queueing delay, 503
+  };
+
+  typedef struct {
+    unsigned long long admitted;
+    unsigned long long busy;
+    unsigned long long route_busy;
+    unsigned long long limited;
+    unsigned long long shed;
+    unsigned int inflight;
+  } tagStats;
+
+  // concurrency / rate 0: unlimited. target 0: no shedding. target and interval in usec
+  explicit AdmissionControl(unsigned int concurrency = 0, double rate = 0, double burst = 0,
+    unsigned int target = CB_LIBRARY_ADMISSION_CONTROL_H_TARGET, unsigned int interval = CB_LIBRARY_ADMISSION_CONTROL_H_INTERVAL);
+  ~AdmissionControl(void);
+  AdmissionControl(const AdmissionControl& rhs) = delete;
+  AdmissionControl& operator =(const AdmissionControl& rhs) = delete;
+
+  // at most concurrency requests at once on the route with this handler (method_t, writer_t or coroutine_t).
+  // before the server starts: lookups don't lock
+  template <typename F>
+  void limit(F handler, unsigned int concurrency) {
+    limit(route(handler), concurrency);
+  }
+  void limit(std::uintptr_t route, unsigned int concurrency);
+
+  template <typename F>
+  static std::uintptr_t route(F handler) {
+    return reinterpret_cast<std::uintptr_t>(handler);
+  }
+
+  // sojourn: nsec the request waited for a thread. eAdmit takes a slot, given back by release()
+  eVerdict admit(const std::string& client, unsigned long long sojourn);
+  void release(void);
+  // a slot of route's, into slot (NULL when it has no limit). false: full
+  bool enter(std::uintptr_t route, std::atomic<unsigned int>*& slot);
+  void leave(std::atomic<unsigned int>* slot);
+  // CoDel alone, for a request that queued again (e.g. for the handler executor)
+  bool shed(unsigned long long sojourn);
+
+  tagStats stats(void) const;
+
+ private:
+  typedef struct {
+    double tokens;
+    unsigned long long refilled; // times::monotonic
+    std::list<const std::string*>::iterator lru;
+  } tagBucket;
+
+  typedef struct {
+    std::mutex mtx;
+    std::unordered_map<std::string, tagBucket> buckets;
+    std::list<const std::string*> lru; // clients in buckets, most recently seen first
+  } tagShard;
+
+  typedef struct {
+    unsigned int limit;
+    std::atomic<unsigned int> inflight;
+  } tagRoute;
+
+  bool take(const std::string& client, unsigned long long now);
+  bool shed(unsigned long long now, unsigned long long sojourn);
+
+ private:
+  unsigned int m_concurrency;
+  double m_rate; // per nsec
+  double m_burst;
+  unsigned long long m_target; // nsec
+  unsigned long long m_interval; // nsec
+
+  std::vector<std::unique_ptr<tagShard>> m_shards;
+  std::unordered_map<std::uintptr_t, std::unique_ptr<tagRoute>> m_routes;
+
+  std::atomic<unsigned int> m_inflight;
+
+  // CoDel, raced on without a lock: a lost update only shifts when shedding starts or stops
+  std::atomic<unsigned long long> m_above; // since when every sojourn was over target, 0: the last one wasn't
+  std::atomic<unsigned long long> m_stopped; // shedding last stopped at
+  std::atomic<unsigned int> m_count; // sheddings in a row, each soon after the last
+  std::atomic<bool> m_shedding;
+
+  std::atomic<unsigned long long> m_admitted;
+  std::atomic<unsigned long long> m_busy;
+  std::atomic<unsigned long long> m_route_busy;
+  std::atomic<unsigned long long> m_limited;
+  std::atomic<unsigned long long> m_shed;
+};
+
+} // namespace library
+} // namespace cb
+
+#endif
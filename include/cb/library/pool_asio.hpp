@@ -0,0 +1,70 @@
+#ifndef CB_LIBRARY_POOL_ASIO_HPP_
+#define CB_LIBRARY_POOL_ASIO_HPP_
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <boost/asio.hpp>
+
+#include "include/cb/common/pool.hpp"
+
+namespace cb {
+namespace library {
+
+// ---------------------------------------------------- tagPoolAsyncGet
+
+// initiation of async_get(): queues on the pool, completes on the handler's executor (ios' when it has none)
+template <typename T>
+struct tagPoolAsyncGet {
+  typedef typename ::cb::common::Pool<T>::Lease lease_t;
+
+  ::cb::common::Pool<T>* pool;
+  boost::asio::io_service* ios;
+
+  template <typename Handler>
+  void operator ()(Handler&& handler) const {
+    typedef typename std::decay<Handler>::type handler_t;
+    typedef typename boost::asio::associated_executor<handler_t, boost::asio::io_service::executor_type>::type executor_t;
+
+    executor_t executor = boost::asio::get_associated_executor(handler, ios->get_executor());
+    // std::function wants it copyable, and the work keeps run() from returning while we wait
+    std::shared_ptr<handler_t> shared(new handler_t(std::forward<Handler>(handler)));
+    std::shared_ptr<boost::asio::executor_work_guard<executor_t>> work(new boost::asio::executor_work_guard<executor_t>(executor));
+
+    pool->lease_async([executor, shared, work](lease_t& lease) {
+      // maybe with the pool locked: only moved on here, used on the executor
+      std::shared_ptr<lease_t> moved(new lease_t(std::move(lease)));
+      boost::asio::post(executor, [shared, work, moved]() {
+        boost::system::error_code ec;
+        if (static_cast<bool>(*moved) == false) {
+          ec = boost::asio::error::operation_aborted;
+        }
+        (*shared)(ec, std::move(*moved));
+        work->reset();
+      });
+    });
+  }
+};
+
+// ---------------------------------------------------- async_get
+
+// a resource without blocking an io_service thread: the handler (or boost::asio::use_future, ...) gets
+// void(error_code, Pool<T>::Lease) once one is free, operation_aborted with an empty lease when the pool was cleared.
+//   async_get(pool, ios, [](const boost::system::error_code& ec, Pool<Db>::Lease db) { ... });
+//   std::future<Pool<Db>::Lease> f = async_get(pool, ios, boost::asio::use_future);
+template <typename T, typename CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken, void(boost::system::error_code, typename ::cb::common::Pool<T>::Lease))
+async_get(::cb::common::Pool<T>& pool, boost::asio::io_service& ios, CompletionToken&& token) {
+  tagPoolAsyncGet<T> initiation;
+  initiation.pool = &pool;
+  initiation.ios = &ios;
+
+  return boost::asio::async_initiate<CompletionToken, void(boost::system::error_code, typename ::cb::common::Pool<T>::Lease)>(
+    initiation, token);
+}
+
+} // namespace library
+} // namespace cb
+
+#endif
@@ -0,0 +1,195 @@
+#include <algorithm>
+#include <functional>
+#include <string>
+
+#include "include/cb/common/times.h"
+#include "include/cb/library/response_cache.h"
+
+namespace {
+
+// length-prefixed, so that no two requests share a key whatever bytes they hold
+void field(std::string& key, const std::string& s) {
+  key.append(std::to_string(s.size())).push_back(':');
+  key.append(s);
+}
+
+} // namespace
+
+namespace cb {
+namespace library {
+
+ResponseCache::ResponseCache(std::size_t budget, unsigned int shards) :
+  m_hits(0),
+  m_misses(0),
+  m_coalesced(0),
+  m_evictions(0),
+  m_expired(0)
+{
+  shards = std::max<unsigned int>(shards, 1);
+  for (unsigned int i = 0; i < shards; ++i) {
+    m_shards.emplace_back(new tagShard);
+    m_shards.back()->bytes = 0;
+  }
+  m_budget = budget / shards;
+}
+
+ResponseCache::~ResponseCache(void) {
+}
+
+ResponseCache::tagShard& ResponseCache::shard(const std::string& key) {
+  return *m_shards[std::hash<std::string>()(key) % m_shards.size()];
+}
+
+void ResponseCache::erase(tagShard& s, std::unordered_map<std::string, tagEntry>::iterator it) {
+  s.bytes -= it->first.size() + it->second.value->size() + CB_LIBRARY_RESPONSE_CACHE_H_LEN_ENTRY;
+  s.lru.erase(it->second.lru);
+  s.entries.erase(it);
+}
+
+std::vector<ResponseCache::waiter_t> ResponseCache::land(tagShard& s, const std::string& key) {
+  std::vector<waiter_t> rtn;
+  auto it = s.flights.find(key);
+
+  if (it != s.flights.end()) {
+    rtn.swap(it->second);
+    s.flights.erase(it);
+  }
+
+  return rtn;
+}
+
+ResponseCache::eLookup ResponseCache::lookup(const std::string& key, value_t& value, waiter_t waiter) {
+  tagShard& s = shard(key);
+  std::lock_guard<std::mutex> guard(s.mtx);
+  auto it = s.entries.find(key);
+
+  if (it != s.entries.end()) {
+    if (it->second.expires > ::cb::common::times::monotonic()) {
+      s.lru.splice(s.lru.begin(), s.lru, it->second.lru);
+      value = it->second.value;
+      m_hits.fetch_add(1, std::memory_order_relaxed);
+
+      return eLookup::eHit;
+    }
+    erase(s, it);
+    m_expired.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto flight = s.flights.find(key);
+  if (flight != s.flights.end()) {
+    flight->second.push_back(std::move(waiter));
+    m_coalesced.fetch_add(1, std::memory_order_relaxed);
+
+    return eLookup::eWait;
+  }
+
+  s.flights[key];
+  m_misses.fetch_add(1, std::memory_order_relaxed);
+
+  return eLookup::eMiss;
+}
+
+ResponseCache::value_t ResponseCache::put(const std::string& key, std::string&& value, unsigned int ttl) {
+  tagShard& s = shard(key);
+  value_t rtn = std::make_shared<const std::string>(std::move(value));
+  std::size_t bytes = key.size() + rtn->size() + CB_LIBRARY_RESPONSE_CACHE_H_LEN_ENTRY;
+  std::vector<waiter_t> waiters;
+
+  {
+    std::lock_guard<std::mutex> guard(s.mtx);
+    auto it = s.entries.find(key);
+
+    waiters = land(s, key);
+    if (it != s.entries.end()) {
+      erase(s, it);
+    }
+    if (bytes <= m_budget && ttl > 0) {
+      while (s.bytes + bytes > m_budget && s.lru.empty() == false) {
+        erase(s, s.entries.find(*s.lru.back()));
+        m_evictions.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      tagEntry& entry = s.entries[key];
+      entry.value = rtn;
+      entry.expires = ::cb::common::times::monotonic() + static_cast<unsigned long long>(ttl) * 1000000ULL;
+      s.lru.push_front(&s.entries.find(key)->first);
+      entry.lru = s.lru.begin();
+      s.bytes += bytes;
+    }
+  }
+
+  // outside the lock, a waiter may look up again
+  for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+    (*it)(rtn);
+  }
+
+  return rtn;
+}
+
+void ResponseCache::fail(const std::string& key) {
+  tagShard& s = shard(key);
+  std::vector<waiter_t> waiters;
+
+  {
+    std::lock_guard<std::mutex> guard(s.mtx);
+    waiters = land(s, key);
+  }
+
+  for (auto it = waiters.begin(); it != waiters.end(); ++it) {
+    (*it)(value_t());
+  }
+}
+
+void ResponseCache::clear(void) {
+  // keys being computed stay: their put() still reaches the waiters
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    std::lock_guard<std::mutex> guard((*it)->mtx);
+    (*it)->entries.clear();
+    (*it)->lru.clear();
+    (*it)->bytes = 0;
+  }
+}
+
+ResponseCache::tagStats ResponseCache::stats(void) const {
+  tagStats rtn;
+
+  rtn.hits = m_hits.load(std::memory_order_relaxed);
+  rtn.misses = m_misses.load(std::memory_order_relaxed);
+  rtn.coalesced = m_coalesced.load(std::memory_order_relaxed);
+  rtn.evictions = m_evictions.load(std::memory_order_relaxed);
+  rtn.expired = m_expired.load(std::memory_order_relaxed);
+  rtn.entries = 0;
+  rtn.bytes = 0;
+  for (auto it = m_shards.begin(); it != m_shards.end(); ++it) {
+    std::lock_guard<std::mutex> guard((*it)->mtx);
+    rtn.entries += (*it)->entries.size();
+    rtn.bytes += (*it)->bytes;
+  }
+
+  return rtn;
+}
+
+std::string ResponseCache::key(const std::string& method, const std::string& path, const std::unordered_map<std::string, std::string>& params) {
+  std::vector<const std::pair<const std::string, std::string>*> sorted;
+  std::string rtn;
+
+  sorted.reserve(params.size());
+  for (auto it = params.begin(); it != params.end(); ++it) {
+    sorted.push_back(&*it);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const std::pair<const std::string, std::string>* lhs, const std::pair<const std::string, std::string>* rhs) {
+    return lhs->first < rhs->first;
+  });
+
+  field(rtn, method);
+  field(rtn, path);
+  for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+    field(rtn, (*it)->first);
+    field(rtn, (*it)->second);
+  }
+
+  return rtn;
+}
+
+} // namespace library
+} // namespace cb
@@ -0,0 +1,95 @@
+#ifndef CB_LIBRARY_RESPONSE_CACHE_H_
+#define CB_LIBRARY_RESPONSE_CACHE_H_
+
+#include <cstddef>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define CB_LIBRARY_RESPONSE_CACHE_H_LEN_BUDGET (64 * 1024 * 1024) // bytes
+#define CB_LIBRARY_RESPONSE_CACHE_H_LEN_SHARDS 16
+#define CB_LIBRARY_RESPONSE_CACHE_H_LEN_ENTRY 96 // bookkeeping bytes counted per entry
+
+namespace cb {
+namespace library {
+
+// response bodies by key, for routes that are pure functions of method, path and params.
+// entries live ttl msec and are evicted least recently used first past the memory budget.
+// concurrent misses on a key are coalesced (singleflight): the first caller computes, the others wait for its put().
+class ResponseCache {
+ public:
+  typedef std::shared_ptr<const std::string> value_t;
+  // the leader's value, NULL when it failed
+  typedef std::function<void(const value_t&)> waiter_t;
+
+  enum class eLookup : unsigned short {
+    eHit = 0, // value set
+    eMiss,    // the caller computes, then put() or fail()
+    eWait,    // waiter is called once the one computing is done
+  };
+
+  typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long coalesced; // eWait
+    unsigned long long evictions; // for the budget
+    unsigned long long expired;
+    std::size_t entries;
+    std::size_t bytes;
+  } tagStats;
+
+  explicit ResponseCache(std::size_t budget = CB_LIBRARY_RESPONSE_CACHE_H_LEN_BUDGET, unsigned int shards = CB_LIBRARY_RESPONSE_CACHE_H_LEN_SHARDS);
+  ~ResponseCache(void);
+  ResponseCache(const ResponseCache& rhs) = delete;
+  ResponseCache& operator =(const ResponseCache& rhs) = delete;
+
+  eLookup lookup(const std::string& key, value_t& value, waiter_t waiter);
+  // stores value for ttl msec (unless it's larger than a shard's budget) and hands it to the waiters
+  value_t put(const std::string& key, std::string&& value, unsigned int ttl);
+  // the waiters get NULL, the next lookup() computes again
+  void fail(const std::string& key);
+  void clear(void);
+
+  tagStats stats(void) const;
+
+  // method, path and params sorted by name
+  static std::string key(const std::string& method, const std::string& path, const std::unordered_map<std::string, std::string>& params);
+
+ private:
+  typedef struct {
+    value_t value;
+    unsigned long long expires; // times::monotonic
+    std::list<const std::string*>::iterator lru;
+  } tagEntry;
+
+  typedef struct {
+    std::mutex mtx;
+    std::unordered_map<std::string, tagEntry> entries;
+    std::list<const std::string*> lru; // keys in entries, most recently used first
+    std::unordered_map<std::string, std::vector<waiter_t>> flights; // keys being computed
+    std::size_t bytes;
+  } tagShard;
+
+  tagShard& shard(const std::string& key);
+  void erase(tagShard& s, std::unordered_map<std::string, tagEntry>::iterator it);
+  std::vector<waiter_t> land(tagShard& s, const std::string& key);
+
+ private:
+  std::vector<std::unique_ptr<tagShard>> m_shards;
+  std::size_t m_budget; // per shard
+  std::atomic<unsigned long long> m_hits;
+  std::atomic<unsigned long long> m_misses;
+  std::atomic<unsigned long long> m_coalesced;
+  std::atomic<unsigned long long> m_evictions;
+  std::atomic<unsigned long long> m_expired;
+};
+
+} // namespace library
+} // namespace cb
+
+#endif
@@ -0,0 +1,209 @@
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include "include/cb/library/response_writer.h"
+
+namespace {
+
+bool equalsNoCase(const std::string& lhs, const char* rhs) {
+  std::size_t len = strlen(rhs);
+
+  if (lhs.size() != len) {
+    return false;
+  }
+  for (std::size_t i = 0; i < len; ++i) {
+    if (tolower(static_cast<unsigned char>(lhs[i])) != tolower(static_cast<unsigned char>(rhs[i]))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+namespace cb {
+namespace library {
+
+ResponseWriter::ResponseWriter(void) :
+  m_code(200),
+  m_typed(false),
+  m_chunked(false),
+  m_failed(false),
+  m_size(0),
+  m_copied(0),
+  m_sent(0),
+  m_fill(0)
+{}
+
+ResponseWriter::~ResponseWriter(void) {
+}
+
+void ResponseWriter::status(unsigned int code) {
+  if (m_chunked == true) {
+    throw std::logic_error("status after the head was sent");
+  }
+
+  m_code = code;
+}
+
+void ResponseWriter::header(const std::string& name, const std::string& value) {
+  if (m_chunked == true) {
+    throw std::logic_error("header after the head was sent: " + name);
+  }
+  if (name.find_first_of("\r\n") != std::string::npos || value.find_first_of("\r\n") != std::string::npos) {
+    throw std::invalid_argument("line break in header: " + name);
+  }
+
+  m_typed = (m_typed == true || equalsNoCase(name, "Content-Type") == true);
+  m_headers.append(name).append(": ").append(value).append("\r\n");
+}
+
+void ResponseWriter::write(const char* data, std::size_t len) {
+  while (len > 0 && m_failed == false) {
+    std::size_t n = std::min<std::size_t>(len, CB_LIBRARY_RESPONSE_WRITER_H_LEN_FLUSH - m_copied);
+
+    append(data, n);
+    data += n;
+    len -= n;
+    flushIfFull();
+  }
+}
+
+void ResponseWriter::write(const std::string& data) {
+  write(data.data(), data.size());
+}
+
+void ResponseWriter::writeRef(const char* data, std::size_t len) {
+  if (len == 0 || m_failed == true) {
+    return;
+  }
+
+  tagSegment seg = { data, len };
+  m_segments.push_back(seg);
+  m_size += len;
+  flushIfFull();
+}
+
+bool ResponseWriter::flush(void) {
+  std::size_t bytes = 0;
+
+  if (m_failed == true) {
+    return false;
+  }
+
+  m_failed = (emit(bytes) == false);
+  m_chunked = true;
+  m_sent += bytes;
+  consume();
+
+  return (m_failed == false);
+}
+
+unsigned int ResponseWriter::code(void) const {
+  return m_code;
+}
+
+const std::string& ResponseWriter::headers(void) const {
+  return m_headers;
+}
+
+bool ResponseWriter::typed(void) const {
+  return m_typed;
+}
+
+bool ResponseWriter::chunked(void) const {
+  return m_chunked;
+}
+
+bool ResponseWriter::failed(void) const {
+  return m_failed;
+}
+
+const std::vector<ResponseWriter::tagSegment>& ResponseWriter::segments(void) const {
+  return m_segments;
+}
+
+std::size_t ResponseWriter::size(void) const {
+  return m_size;
+}
+
+std::size_t ResponseWriter::sent(void) const {
+  return m_sent;
+}
+
+void ResponseWriter::consume(void) {
+  m_segments.clear();
+  m_size = 0;
+  m_copied = 0;
+
+  // every block is free again, the one being filled as well
+  for (auto it = m_blocks.begin(); it != m_blocks.end(); ++it) {
+    m_spare.push_back(std::move(*it));
+  }
+  m_blocks.clear();
+  m_fill = 0;
+}
+
+void ResponseWriter::abort(void) {
+  m_failed = true;
+}
+
+void ResponseWriter::clear(void) {
+  consume();
+  if (m_spare.size() > CB_LIBRARY_RESPONSE_WRITER_H_LEN_SPARE) {
+    m_spare.resize(CB_LIBRARY_RESPONSE_WRITER_H_LEN_SPARE);
+  }
+  if (m_segments.capacity() > CB_LIBRARY_RESPONSE_WRITER_H_LEN_SEGMENTS) {
+    std::vector<tagSegment>().swap(m_segments);
+  }
+
+  m_code = 200;
+  m_headers.clear();
+  m_typed = false;
+  m_chunked = false;
+  m_failed = false;
+  m_sent = 0;
+}
+
+void ResponseWriter::append(const char* data, std::size_t len) {
+  while (len > 0) {
+    if (m_blocks.empty() == true || m_fill == CB_LIBRARY_RESPONSE_WRITER_H_LEN_BLOCK) {
+      if (m_spare.empty() == true) {
+        m_blocks.emplace_back(new char[CB_LIBRARY_RESPONSE_WRITER_H_LEN_BLOCK]);
+      } else {
+        m_blocks.push_back(std::move(m_spare.back()));
+        m_spare.pop_back();
+      }
+      m_fill = 0;
+    }
+
+    char* dst = m_blocks.back().get() + m_fill;
+    std::size_t n = std::min<std::size_t>(len, CB_LIBRARY_RESPONSE_WRITER_H_LEN_BLOCK - m_fill);
+
+    memcpy(dst, data, n);
+    // right after the last segment: one segment for consecutive writes
+    if (m_fill > 0 && m_segments.empty() == false && m_segments.back().data + m_segments.back().len == dst) {
+      m_segments.back().len += n;
+    } else {
+      tagSegment seg = { dst, n };
+      m_segments.push_back(seg);
+    }
+    m_fill += n;
+    m_size += n;
+    m_copied += n;
+    data += n;
+    len -= n;
+  }
+}
+
+void ResponseWriter::flushIfFull(void) {
+  if (m_copied >= CB_LIBRARY_RESPONSE_WRITER_H_LEN_FLUSH || m_segments.size() >= CB_LIBRARY_RESPONSE_WRITER_H_LEN_SEGMENTS) {
+    flush();
+  }
+}
+
+} // namespace library
+} // namespace cb
@@ -0,0 +1,93 @@
+#ifndef CB_LIBRARY_RESPONSE_WRITER_H_
+#define CB_LIBRARY_RESPONSE_WRITER_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define CB_LIBRARY_RESPONSE_WRITER_H_LEN_BLOCK 16384 // bytes per buffer block
+#define CB_LIBRARY_RESPONSE_WRITER_H_LEN_FLUSH 65536 // copied bytes pending before write() flushes by itself
+#define CB_LIBRARY_RESPONSE_WRITER_H_LEN_SEGMENTS 64 // segments pending before write() / writeRef() flush by itself
+#define CB_LIBRARY_RESPONSE_WRITER_H_LEN_SPARE 4 // idle blocks kept for the next response
+
+namespace cb {
+namespace library {
+
+// the body (and status, headers) of a response, given to a RouterHttp::writer_t handler.
+// write() copies into blocks the writer keeps from one response to the next, writeRef() only points at the caller's memory.
+// what's pending goes out with Content-Length when the handler returns, unless it was flushed before:
+// then the head goes out with Transfer-Encoding: chunked, and every flush() writes one chunk.
+// write() flushes by itself past CB_LIBRARY_RESPONSE_WRITER_H_LEN_FLUSH, so a response of any size holds about that much.
+class ResponseWriter {
+ public:
+  typedef struct {
+    const char* data;
+    std::size_t len;
+  } tagSegment;
+
+  ResponseWriter(void);
+  virtual ~ResponseWriter(void);
+  ResponseWriter(const ResponseWriter& rhs) = delete;
+  ResponseWriter& operator =(const ResponseWriter& rhs) = delete;
+
+  // 200 unless set, before the first flush
+  void status(unsigned int code);
+  // before the first flush. throws std::invalid_argument for a CR / LF in either, std::logic_error once the head is out
+  void header(const std::string& name, const std::string& value);
+  void write(const char* data, std::size_t len);
+  void write(const std::string& data);
+  // data has to stay valid up to the next flush() (static data, a cache entry, ...), or until the response is sent
+  void writeRef(const char* data, std::size_t len);
+  // sends the pending segments as a chunk, blocking the handler executor's thread. false: the peer is gone and the rest is dropped
+  bool flush(void);
+
+  unsigned int code(void) const;
+  // "Name: value\r\n" lines set by header()
+  const std::string& headers(void) const;
+  // a Content-Type was set
+  bool typed(void) const;
+  // the head went out (Transfer-Encoding: chunked)
+  bool chunked(void) const;
+  bool failed(void) const;
+  // pending
+  const std::vector<tagSegment>& segments(void) const;
+  std::size_t size(void) const;
+  // bytes flushed so far, the head included
+  std::size_t sent(void) const;
+
+  // drops the pending segments, the blocks are reused
+  void consume(void);
+  // no more flushes: the response can't be finished (e.g. the handler threw after the head went out)
+  void abort(void);
+  // for the next response, keeping up to CB_LIBRARY_RESPONSE_WRITER_H_LEN_SPARE blocks
+  void clear(void);
+
+ protected:
+  // writes the head (when !chunked()) and the pending segments as a chunk. bytes: written
+  virtual bool emit(std::size_t& bytes) = 0;
+
+ private:
+  void append(const char* data, std::size_t len);
+  void flushIfFull(void);
+
+ private:
+  unsigned int m_code;
+  std::string m_headers;
+  bool m_typed;
+  bool m_chunked;
+  bool m_failed;
+  std::vector<tagSegment> m_segments;
+  std::size_t m_size; // pending
+  std::size_t m_copied; // pending in m_blocks
+  std::size_t m_sent;
+
+  std::vector<std::unique_ptr<char[]>> m_blocks; // in use, the last one being filled
+  std::vector<std::unique_ptr<char[]>> m_spare;
+  std::size_t m_fill; // of m_blocks.back()
+};
+
+} // namespace library
+} // namespace cb
+
+#endif
@@ -1,14 +1,49 @@
 #ifndef CB_LIBRARY_ROUTER_HTTP_HPP_
 #define CB_LIBRARY_ROUTER_HTTP_HPP_
 
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <boost/asio/awaitable.hpp>
+#endif
 
 #include "include/cb/common/types.h"
 
+#define CB_LIBRARY_ROUTER_HTTP_HPP_NIL 0xffffffffU
+#define CB_LIBRARY_ROUTER_HTTP_HPP_LEN_PARAMS 16 // captures per route
+
+// coroutine_t routes, where the compiler and Boost.Asio have co_await
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+#define CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE 1
+#endif
+
 namespace cb {
 namespace library {
 
+class ResponseWriter;
+
+// compressed radix tree of routes, with a handler table per method on every node.
+// a pattern is made of static text, ":name" captures (up to the next '/') and a trailing "*name" capturing the rest:
+//   add("GET", "/users/:id/posts", ...); add("*", "/static/*path", ...);
+// static children are tried first, then the capture, then the wildcard.
+// routes() / route() are the exact-path map of before, merged into the tree (any method) by compile().
+// a route answers with the string a method_t returns, or streams it through the ResponseWriter a writer_t gets.
+// an offload route runs on the server's handler executor (if it has one) instead of the io thread.
+// a writer_t route always does, the server answers it with 500 when it has no executor.
+// a method_t route with a cache ttl (msec) answers GET / HEAD from the server's ResponseCache, if it has one.
+// a coroutine_t route (C++20) runs on the io_service and gives the thread up at every co_await:
+//   boost::asio::awaitable<std::string> user(const HttpRequest& req) {
+//     auto db = co_await async_get(pool, ios, boost::asio::use_awaitable);
+//     co_return ...;
+//   }
+//   add("GET", "/users/:id", user);
+// req stays valid until the response is sent.
 class RouterHttp {
  public:
   //RouterHttp(void) {}
@@ -16,6 +51,43 @@ class RouterHttp {
   //RouterHttp& operator = (const RouterHttp& rhs) {}
 
   typedef std::string(*method_t)(const ::cb::common::types::HttpRequest&);
+  typedef void(*writer_t)(const ::cb::common::types::HttpRequest&, ResponseWriter&);
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+  typedef boost::asio::awaitable<std::string>(*coroutine_t)(const ::cb::common::types::HttpRequest&);
+#endif
+
+  enum class eMethod : unsigned short {
+    eGet = 0,
+    eHead,
+    ePost,
+    ePut,
+    eDelete,
+    ePatch,
+    eOptions,
+    eAny, // "*" or "", when the method has none of its own
+    eLength,
+  };
+
+  // a capture as offsets into the looked up path
+  typedef struct {
+    const std::string* name;
+    std::size_t pos;
+    std::size_t len;
+  } tagCapture;
+
+  typedef struct {
+    method_t handler; // both NULL: not found
+    writer_t writer;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    coroutine_t coroutine;
+#endif
+    bool offload;
+    unsigned int cache; // ttl msec, 0: not cached
+    bool path; // the path has a route, for another method (405)
+    unsigned short methods; // bits (1 << eMethod) of the methods routed on the path, for Allow
+    unsigned short size;
+    tagCapture captures[CB_LIBRARY_ROUTER_HTTP_HPP_LEN_PARAMS];
+  } tagMatch;
 
   std::unordered_map<std::string, method_t>& routes(void) {
     return m_routes;
@@ -25,11 +97,369 @@ class RouterHttp {
     return m_routes[k];
   }
 
+  // throws std::invalid_argument for a pattern that can't be told apart from one added before
+  void add(const std::string& method, const std::string& pattern, method_t handler, bool offload = false, unsigned int cache = 0) {
+    tagHandler& h = leaf(pattern).handlers[static_cast<unsigned short>(toMethod(method))];
+
+    h.handler = handler;
+    h.writer = NULL;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    h.coroutine = NULL;
+#endif
+    h.offload = offload;
+    h.cache = cache;
+  }
+
+  // always offloaded: flush() blocks on the socket, which an io thread mustn't
+  void add(const std::string& method, const std::string& pattern, writer_t writer) {
+    tagHandler& h = leaf(pattern).handlers[static_cast<unsigned short>(toMethod(method))];
+
+    h.handler = NULL;
+    h.writer = writer;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    h.coroutine = NULL;
+#endif
+    h.offload = true;
+    h.cache = 0;
+  }
+
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+  // never offloaded: the coroutine doesn't hold the io thread while it waits
+  void add(const std::string& method, const std::string& pattern, coroutine_t coroutine) {
+    tagHandler& h = leaf(pattern).handlers[static_cast<unsigned short>(toMethod(method))];
+
+    h.handler = NULL;
+    h.writer = NULL;
+    h.coroutine = coroutine;
+    h.offload = false;
+    h.cache = 0;
+  }
+#endif
+
+  // adds routes() to the tree, for any method
+  void compile(void) {
+    for (auto it = m_routes.begin(); it != m_routes.end(); ++it) {
+      if (it->second != NULL) {
+        add("*", it->first, it->second);
+      }
+    }
+  }
+
+  bool empty(void) const {
+    return (m_routes.empty() == true && m_nodes.size() <= 1);
+  }
+
+  // one walk down the tree, no allocation
+  bool match(const std::string& method, const std::string& path, tagMatch& rtn) const {
+    rtn.handler = NULL;
+    rtn.writer = NULL;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    rtn.coroutine = NULL;
+#endif
+    rtn.offload = false;
+    rtn.cache = 0;
+    rtn.path = false;
+    rtn.methods = 0;
+    rtn.size = 0;
+
+    if (m_nodes.empty() == true) {
+      return false;
+    }
+
+    return match(0, toMethod(method), path.c_str(), path.size(), 0, rtn);
+  }
+
+  // match() with the captures put into req.params. NULL when not found or a writer_t, put into *writer (if given).
+  // *path_found as in tagMatch
+  method_t find(const std::string& method, const std::string& path, ::cb::common::types::HttpRequest& req, bool* path_found = NULL, writer_t* writer = NULL) const {
+    tagMatch rtn;
+
+    match(method, path, rtn);
+    capture(path, rtn, req);
+    if (path_found != NULL) {
+      *path_found = rtn.path;
+    }
+    if (writer != NULL) {
+      *writer = rtn.writer;
+    }
+
+    return rtn.handler;
+  }
+
+  // m's captures (of path) into req.params
+  static void capture(const std::string& path, const tagMatch& m, ::cb::common::types::HttpRequest& req) {
+    for (unsigned short i = 0; i < m.size; ++i) {
+      req.params[*m.captures[i].name].assign(path, m.captures[i].pos, m.captures[i].len);
+    }
+  }
+
+  static eMethod toMethod(const std::string& method) {
+    for (unsigned short i = 0; i < static_cast<unsigned short>(eMethod::eAny); ++i) {
+      if (method.compare(names()[i]) == 0) {
+        return static_cast<eMethod>(i);
+      }
+    }
+
+    return eMethod::eAny;
+  }
+
+  // tagMatch::methods as an Allow value ("GET, HEAD, POST") appended to rtn. HEAD comes with GET
+  static void allow(unsigned short methods, std::string& rtn) {
+    if ((methods & (1 << static_cast<unsigned short>(eMethod::eGet))) != 0) {
+      methods |= (1 << static_cast<unsigned short>(eMethod::eHead));
+    }
+    const char* delim = "";
+
+    for (unsigned short i = 0; i < static_cast<unsigned short>(eMethod::eAny); ++i) {
+      if ((methods & (1 << i)) != 0) {
+        rtn.append(delim).append(names()[i]);
+        delim = ", ";
+      }
+    }
+  }
+
+ private:
+  typedef struct {
+    method_t handler;
+    writer_t writer;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    coroutine_t coroutine;
+#endif
+    bool offload;
+    unsigned int cache;
+  } tagHandler;
+
+  typedef struct {
+    std::string prefix; // static text, the first char tells the siblings apart
+    std::string name; // of the capture / wildcard node
+    std::vector<unsigned int> children; // static
+    unsigned int param;
+    unsigned int wildcard;
+    tagHandler handlers[static_cast<unsigned short>(eMethod::eLength)];
+  } tagNode;
+
+  // the node pattern ends at, made on the way
+  tagNode& leaf(const std::string& pattern) {
+    unsigned int n = root(), name_end;
+    std::size_t pos = 0, end;
+    unsigned short captures = 0;
+
+    while (pos < pattern.size()) {
+      if (pattern[pos] == ':' || pattern[pos] == '*') {
+        bool wildcard = (pattern[pos] == '*');
+        end = (wildcard == true) ? pattern.size() : std::min(pattern.find('/', pos), pattern.size());
+        std::string name = pattern.substr(pos + 1, end - pos - 1);
+        unsigned int child = (wildcard == true) ? m_nodes[n].wildcard : m_nodes[n].param;
+
+        if (++captures > CB_LIBRARY_ROUTER_HTTP_HPP_LEN_PARAMS) {
+          throw std::invalid_argument("too many captures: " + pattern);
+        }
+        if (child == CB_LIBRARY_ROUTER_HTTP_HPP_NIL) {
+          child = node(std::string());
+          m_nodes[child].name = name;
+          if (wildcard == true) {
+            m_nodes[n].wildcard = child;
+          } else {
+            m_nodes[n].param = child;
+          }
+        } else if (m_nodes[child].name != name) {
+          throw std::invalid_argument("capture named differently (" + m_nodes[child].name + "): " + pattern);
+        }
+        n = child;
+        pos = end;
+        if (wildcard == true) {
+          break;
+        }
+      } else {
+        name_end = static_cast<unsigned int>(std::min(pattern.find_first_of(":*", pos), pattern.size()));
+        n = insert(n, pattern.c_str() + pos, name_end - pos);
+        pos = name_end;
+      }
+    }
+
+    return m_nodes[n];
+  }
+
+  unsigned int root(void) {
+    if (m_nodes.empty() == true) {
+      node(std::string());
+    }
+
+    return 0;
+  }
+
+  unsigned int node(const std::string& prefix) {
+    tagNode n;
+
+    n.prefix = prefix;
+    n.param = CB_LIBRARY_ROUTER_HTTP_HPP_NIL;
+    n.wildcard = CB_LIBRARY_ROUTER_HTTP_HPP_NIL;
+    for (unsigned short i = 0; i < static_cast<unsigned short>(eMethod::eLength); ++i) {
+      n.handlers[i].handler = NULL;
+      n.handlers[i].writer = NULL;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+      n.handlers[i].coroutine = NULL;
+#endif
+      n.handlers[i].offload = false;
+      n.handlers[i].cache = 0;
+    }
+    m_nodes.push_back(n);
+
+    return static_cast<unsigned int>(m_nodes.size() - 1);
+  }
+
+  // static text s below n, splitting a child that shares only part of it. returns the node ending at s
+  unsigned int insert(unsigned int n, const char* s, std::size_t len) {
+    while (len > 0) {
+      unsigned int found = CB_LIBRARY_ROUTER_HTTP_HPP_NIL;
+      std::size_t i = 0, common = 0;
+
+      for (i = 0; i < m_nodes[n].children.size(); ++i) {
+        if (m_nodes[m_nodes[n].children[i]].prefix[0] == s[0]) {
+          found = m_nodes[n].children[i];
+          break;
+        }
+      }
+      if (found == CB_LIBRARY_ROUTER_HTTP_HPP_NIL) {
+        unsigned int child = node(std::string(s, len));
+        m_nodes[n].children.push_back(child);
+        return child;
+      }
+
+      const std::string& prefix = m_nodes[found].prefix;
+      while (common < len && common < prefix.size() && prefix[common] == s[common]) {
+        ++common;
+      }
+      if (common < prefix.size()) {
+        // found keeps the tail, a new node takes the shared head
+        unsigned int head = node(prefix.substr(0, common));
+        m_nodes[found].prefix.erase(0, common);
+        m_nodes[head].children.push_back(found);
+        m_nodes[n].children[i] = head;
+        found = head;
+      }
+
+      n = found;
+      s += common;
+      len -= common;
+    }
+
+    return n;
+  }
+
+  static bool routed(const tagHandler& h) {
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    if (h.coroutine != NULL) {
+      return true;
+    }
+#endif
+    return (h.handler != NULL || h.writer != NULL);
+  }
+
+  // the method's handler, into rtn. false: none
+  bool handler(const tagNode& n, eMethod method, tagMatch& rtn) const {
+    const tagHandler* h = &n.handlers[static_cast<unsigned short>(method)];
+
+    if (routed(*h) == false && method == eMethod::eHead) {
+      h = &n.handlers[static_cast<unsigned short>(eMethod::eGet)];
+    }
+    if (routed(*h) == false) {
+      h = &n.handlers[static_cast<unsigned short>(eMethod::eAny)];
+    }
+    rtn.handler = h->handler;
+    rtn.writer = h->writer;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+    rtn.coroutine = h->coroutine;
+#endif
+    rtn.offload = h->offload;
+    rtn.cache = h->cache;
+
+    return routed(*h);
+  }
+
+  static const char* const* names(void) {
+    static const char* const rtn[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS" };
+
+    return rtn;
+  }
+
+  // bits (1 << eMethod) of the methods n has a handler for
+  unsigned short routed(const tagNode& n) const {
+    unsigned short rtn = 0;
+
+    for (unsigned short i = 0; i < static_cast<unsigned short>(eMethod::eLength); ++i) {
+      if (routed(n.handlers[i]) == true) {
+        rtn |= (1 << i);
+      }
+    }
+
+    return rtn;
+  }
+
+  // n's own prefix is matched up to pos
+  bool match(unsigned int n, eMethod method, const char* path, std::size_t len, std::size_t pos, tagMatch& rtn) const {
+    const tagNode& curr = m_nodes[n];
+
+    if (pos == len) {
+      rtn.methods |= routed(curr);
+      rtn.path = (rtn.methods != 0);
+      if (handler(curr, method, rtn) == true) {
+        return true;
+      }
+    } else {
+      for (auto it = curr.children.begin(); it != curr.children.end(); ++it) {
+        const std::string& prefix = m_nodes[*it].prefix;
+        if (prefix[0] != path[pos]) {
+          continue;
+        }
+        if (prefix.size() <= len - pos && memcmp(prefix.data(), path + pos, prefix.size()) == 0 &&
+          match(*it, method, path, len, pos + prefix.size(), rtn) == true) {
+          return true;
+        }
+        break;
+      }
+
+      if (curr.param != CB_LIBRARY_ROUTER_HTTP_HPP_NIL) {
+        const char* slash = static_cast<const char*>(memchr(path + pos, '/', len - pos));
+        std::size_t end = (slash == NULL) ? len : static_cast<std::size_t>(slash - path);
+        if (end > pos) {
+          unsigned short size = rtn.size;
+          rtn.captures[size].name = &m_nodes[curr.param].name;
+          rtn.captures[size].pos = pos;
+          rtn.captures[size].len = end - pos;
+          rtn.size = size + 1;
+          if (match(curr.param, method, path, len, end, rtn) == true) {
+            return true;
+          }
+          rtn.size = size;
+        }
+      }
+    }
+
+    if (curr.wildcard != CB_LIBRARY_ROUTER_HTTP_HPP_NIL) {
+      const tagNode& wildcard = m_nodes[curr.wildcard];
+      rtn.methods |= routed(wildcard);
+      rtn.path = (rtn.methods != 0);
+      if (handler(wildcard, method, rtn) == true) {
+        rtn.captures[rtn.size].name = &wildcard.name;
+        rtn.captures[rtn.size].pos = pos;
+        rtn.captures[rtn.size].len = len - pos;
+        ++rtn.size;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
  protected:
   std::unordered_map<std::string, method_t> m_routes;
+
+ private:
+  std::vector<tagNode> m_nodes; // [0]: root
 };
 
 } // namespace library
 } // namespace cb
 
-#endif
\ No newline at end of file
+#endif
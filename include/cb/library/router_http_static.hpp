@@ -0,0 +1,214 @@
+#ifndef CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+#include "include/cb/library/router_http.hpp"
+
+// the table is built by the compiler from C++14 on, once at static initialization before that
+#if __cplusplus >= 201402L
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR constexpr
+#else
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR
+#endif
+
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_TRIES (1 << 20) // displacements tried per bucket
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_METHOD(m) (1 << static_cast<unsigned short>(::cb::library::RouterHttp::eMethod::m))
+// GET (and HEAD), or the methods given, e.g. CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_METHOD(ePost) | ...
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE(path, handler) { path, sizeof(path) - 1, handler, CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_METHOD(eGet) }
+#define CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE_METHODS(path, handler, methods) { path, sizeof(path) - 1, handler, static_cast<unsigned short>(methods) }
+
+namespace cb {
+namespace library {
+
+typedef struct {
+  const char* path;
+  std::size_t len;
+  RouterHttp::method_t handler;
+  unsigned short methods; // bits (1 << RouterHttp::eMethod), HEAD comes with GET, eAny takes every method
+} tagRouteStatic;
+
+// what ServerHttpBoost::setServiceRouter() takes of a RouterHttpStatic<N>
+class IRouterHttpStatic {
+ public:
+  // NULL when path isn't in the table, or not for method. methods: the path's, 0 when it isn't in the table
+  virtual RouterHttp::method_t find(const char* path, std::size_t len, RouterHttp::eMethod method, unsigned short& methods) const = 0;
+};
+
+// ---------------------------------------------------- RouterHttpStatic
+
+// a fixed set of exact paths (and their methods) in a perfect hash table (hash and displace):
+// a lookup hashes the path once, reads two arrays and compares one candidate. no std::string, no heap.
+//   const tagRouteStatic routes[] = { CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE("/a", a), ... };
+//   static const RouterHttpStatic<3> table(routes);
+// throws std::invalid_argument for duplicated paths (a compile-time error where the table is constexpr).
+template <std::size_t N>
+class RouterHttpStatic : public IRouterHttpStatic {
+ public:
+  static constexpr std::size_t pow2(std::size_t n, std::size_t p = 1) {
+    return (p >= n) ? p : pow2(n, p * 2);
+  }
+
+  static constexpr std::size_t LEN_BUCKETS = N / 2 + 1;
+  static constexpr std::size_t LEN_SLOTS = pow2(N); // load factor over 1/2
+
+  CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR explicit RouterHttpStatic(const tagRouteStatic (&routes)[N]) : m_routes(), m_disp(), m_slots() {
+    std::size_t counts[LEN_BUCKETS] = {}, filled[LEN_BUCKETS] = {}, starts[LEN_BUCKETS + 1] = {}, order[LEN_BUCKETS] = {};
+    std::size_t members[N] = {}, taken[N] = {};
+    unsigned long long hashes[N] = {};
+    bool used[LEN_SLOTS] = {};
+
+    for (std::size_t i = 0; i < N; ++i) {
+      m_routes[i] = routes[i];
+      hashes[i] = hash(routes[i].path, routes[i].len);
+      ++counts[bucket(hashes[i])];
+    }
+    // keys grouped by bucket
+    for (std::size_t b = 0; b < LEN_BUCKETS; ++b) {
+      starts[b + 1] = starts[b] + counts[b];
+      order[b] = b;
+    }
+    for (std::size_t i = 0; i < N; ++i) {
+      std::size_t b = bucket(hashes[i]);
+      members[starts[b] + filled[b]++] = i;
+    }
+    // the largest buckets first, while most slots are free
+    for (std::size_t i = 1; i < LEN_BUCKETS; ++i) {
+      for (std::size_t j = i; j > 0 && size(starts, order[j]) > size(starts, order[j - 1]); --j) {
+        std::size_t t = order[j];
+        order[j] = order[j - 1];
+        order[j - 1] = t;
+      }
+    }
+
+    for (std::size_t i = 0; i < LEN_BUCKETS; ++i) {
+      std::size_t b = order[i], n = size(starts, b);
+      unsigned int d = 1;
+      if (n == 0) {
+        break;
+      }
+
+      for (; d < CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_TRIES; ++d) {
+        bool fits = true;
+        for (std::size_t k = 0; k < n && fits == true; ++k) {
+          taken[k] = slot(hashes[members[starts[b] + k]], d);
+          fits = (used[taken[k]] == false);
+          for (std::size_t l = 0; l < k && fits == true; ++l) {
+            fits = (taken[l] != taken[k]);
+          }
+        }
+        if (fits == true) {
+          break;
+        }
+      }
+      if (d == CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_TRIES) {
+        throw std::invalid_argument("duplicated route (or no perfect hash for the table)");
+      }
+
+      m_disp[b] = d;
+      for (std::size_t k = 0; k < n; ++k) {
+        used[taken[k]] = true;
+        m_slots[taken[k]] = static_cast<unsigned int>(members[starts[b] + k] + 1);
+      }
+    }
+  }
+
+  RouterHttp::method_t find(const char* path, std::size_t len, RouterHttp::eMethod method, unsigned short& methods) const override {
+    unsigned long long h = hashFast(path, len);
+    unsigned int i = m_slots[slot(h, m_disp[bucket(h)])];
+
+    methods = 0;
+    if (i == 0) {
+      return NULL;
+    }
+
+    const tagRouteStatic& route = m_routes[i - 1];
+
+    if (route.len != len || memcmp(route.path, path, len) != 0) {
+      return NULL;
+    }
+    methods = route.methods;
+    if (method == RouterHttp::eMethod::eHead) {
+      method = RouterHttp::eMethod::eGet;
+    }
+
+    return ((methods & ((1 << static_cast<unsigned short>(method)) | CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_METHOD(eAny))) != 0) ? route.handler : NULL;
+  }
+
+ private:
+  // 8 bytes at a time; the bucket takes the high half, the slot a multiply-shift of the hash and the displacement.
+  // hash() builds the table, hashFast() (same values) looks it up with plain loads where the byte order allows
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR unsigned long long word(const char* s, std::size_t n) {
+    unsigned long long rtn = 0;
+
+    for (std::size_t k = 0; k < n; ++k) {
+      rtn |= static_cast<unsigned long long>(static_cast<unsigned char>(s[k])) << (k * 8);
+    }
+
+    return rtn;
+  }
+
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR unsigned long long step(unsigned long long h, unsigned long long w) {
+    h = (h ^ w) * 0x100000001b3ULL;
+
+    return h ^ (h >> 29);
+  }
+
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR unsigned long long hash(const char* s, std::size_t len) {
+    unsigned long long rtn = 0xcbf29ce484222325ULL ^ len;
+    std::size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+      rtn = step(rtn, word(s + i, 8));
+    }
+    rtn = step(rtn, word(s + i, len - i)) * 0x9e3779b97f4a7c15ULL;
+
+    return rtn ^ (rtn >> 32);
+  }
+
+  static unsigned long long hashFast(const char* s, std::size_t len) {
+#if defined(_WIN32) || defined(_WIN64) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    unsigned long long rtn = 0xcbf29ce484222325ULL ^ len, w = 0;
+    std::size_t i = 0;
+
+    for (; i + 8 <= len; i += 8) {
+      memcpy(&w, s + i, 8);
+      rtn = step(rtn, w);
+    }
+    rtn = step(rtn, word(s + i, len - i)) * 0x9e3779b97f4a7c15ULL;
+
+    return rtn ^ (rtn >> 32);
+#else
+    return hash(s, len);
+#endif
+  }
+
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR std::size_t bucket(unsigned long long h) {
+    return static_cast<std::size_t>(((h >> 32) * LEN_BUCKETS) >> 32);
+  }
+
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR std::size_t slot(unsigned long long h, unsigned int d) {
+    return static_cast<std::size_t>(((h ^ (d * 0xc2b2ae3d27d4eb4fULL)) * 0x165667b19e3779f9ULL) >> 32) & (LEN_SLOTS - 1);
+  }
+
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR std::size_t size(const std::size_t (&starts)[LEN_BUCKETS + 1], std::size_t b) {
+    return starts[b + 1] - starts[b];
+  }
+
+ private:
+  tagRouteStatic m_routes[N];
+  unsigned int m_disp[LEN_BUCKETS]; // per bucket, 0: empty
+  unsigned int m_slots[LEN_SLOTS]; // route + 1, 0: empty
+};
+
+template <std::size_t N>
+CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR RouterHttpStatic<N> makeRouterHttpStatic(const tagRouteStatic (&routes)[N]) {
+  return RouterHttpStatic<N>(routes);
+}
+
+} // namespace library
+} // namespace cb
+
+#endif
@@ -5,79 +5,259 @@
  */
 
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 #include <atomic>
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
+
 #include <boost/asio.hpp>
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+#include <boost/asio/co_spawn.hpp>
+#endif
 #include <boost/system/error_code.hpp>
 #include <boost/filesystem.hpp>
 
 #include "include/cb/common/defines.h"
+#include "include/cb/common/executor.h"
+#include "include/cb/common/rcu.hpp"
 #include "include/cb/common/types.h"
+#include "include/cb/common/times.h"
 #include "include/cb/common/utils.hpp"
 #include "include/cb/common/logger.h"
+#include "include/cb/library/access_log.h"
+#include "include/cb/library/admission_control.h"
+#include "include/cb/library/response_cache.h"
+#include "include/cb/library/response_writer.h"
 #include "include/cb/library/server_http_boost.h"
 
+namespace cb {
+namespace common {
+namespace logfmt {
+
+// address:port ([address]:port for v6)
+template <>
+struct FormatArg<boost::asio::ip::tcp::endpoint> {
+  static void append(std::string& buf, const boost::asio::ip::tcp::endpoint& v) {
+    boost::system::error_code ec;
+    std::string address = v.address().to_string(ec);
+
+    if (v.address().is_v6() == true) {
+      buf.push_back('[');
+      buf.append(address);
+      buf.push_back(']');
+    } else {
+      buf.append(address);
+    }
+    buf.push_back(':');
+    appendInteger(buf, v.port());
+  }
+};
+
+} // namespace logfmt
+} // namespace common
+} // namespace cb
+
 namespace {
 
 uintmax_t max_res_filesize = 1024 * 1024 * 10;
 std::string service_static;
-::cb::library::RouterHttp service_router;
+// swapped by setServiceRouter() while requests read them
+::cb::common::Rcu<::cb::library::RouterHttp> service_router(new ::cb::library::RouterHttp);
+std::atomic<const ::cb::library::IRouterHttpStatic*> service_router_static(NULL); // tried before service_router
+std::unique_ptr<::cb::library::AccessLog> access_log;
+std::unique_ptr<::cb::common::Executor> handler_executor; // offload routes, off the io threads
+std::atomic<unsigned int> offloaded(0); // queued on handler_executor, send_response() not run yet
+std::unique_ptr<::cb::library::ResponseCache> response_cache; // routes with a cache ttl
+std::unique_ptr<::cb::library::AdmissionControl> admission; // checked before routing
+unsigned int keep_alive_timeout = CB_LIBRARY_SERVER_HTTP_BOOST_H_KEEP_ALIVE; // msec, 0: a request per connection
+unsigned int keep_alive_requests = CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_KEEP_ALIVE;
+::cb::common::Histogram latency; // nsec, accept ~ response sent
+
+// empties c, giving its memory back when it grew past what a recycled service may keep
+template <typename C>
+void retain(C& c) {
+  c.clear();
+  if (c.capacity() > CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_RETAIN) {
+    C().swap(c);
+  }
+}
+
+// the next space-separated token of [pos, end) into [first, first + length), pos past it
+std::size_t token(const char*& pos, const char* end, const char*& first) {
+  while (pos < end && (*pos == ' ' || *pos == '\t')) {
+    ++pos;
+  }
+  first = pos;
+  while (pos < end && *pos != ' ' && *pos != '\t') {
+    ++pos;
+  }
+
+  return static_cast<std::size_t>(pos - first);
+}
+
+// the matched route's key for AdmissionControl::limit(), 0 when not found
+std::uintptr_t route(const ::cb::library::RouterHttp::tagMatch& match) {
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+  if (match.coroutine != NULL) {
+    return ::cb::library::AdmissionControl::route(match.coroutine);
+  }
+#endif
+  if (match.writer != NULL) {
+    return ::cb::library::AdmissionControl::route(match.writer);
+  }
+
+  return ::cb::library::AdmissionControl::route(match.handler);
+}
+
+class ServerHttpBoostService;
+
+// a writer_t route's writer, flushing straight to the service's socket
+class ServerHttpBoostWriter : public ::cb::library::ResponseWriter {
+ public:
+  explicit ServerHttpBoostWriter(ServerHttpBoostService* service) : m_service(service) {}
+
+ protected:
+  bool emit(std::size_t& bytes) override;
 
-// processor
+ private:
+  ServerHttpBoostService* m_service;
+};
+
+// processor, recycled through the acceptor's free lists
 class ServerHttpBoostService {
+  friend class ServerHttpBoostWriter;
+
   static const std::map<unsigned int, std::string> http_status_table;
   static const std::string delim_line_each;
   static const std::string delim_line_section;
 
  public:
-  ServerHttpBoostService(std::shared_ptr<boost::asio::ip::tcp::socket> sock);
+  ServerHttpBoostService(boost::asio::io_service& ios, ServerHttpBoostAcceptor* owner);
   virtual ~ServerHttpBoostService();
 
+  boost::asio::ip::tcp::socket& socket();
+  // after the socket was accepted
   void start_handling();
+  // back to the state of a new one, keeping the grown buffers (up to CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_RETAIN each)
+  void reset();
   void lock();
   void unlock();
 
  private:
+  // reset() for the next request on the connection, which stays open
+  void reset_request();
+  // the next request line, with the idle timer armed. it may be in m_request already (pipelined)
+  void read_request();
+  // waiting is the request the timer was armed for
+  void on_idle(const boost::system::error_code& ec, unsigned int waiting);
   void on_request_line_received(const boost::system::error_code& ec, std::size_t bytes_transferred);
+  // the header block (bytes of m_request) into m_request_headers, names lowercased
+  void parse_headers(std::size_t bytes);
+  // NULL when the request hasn't it. name lowercase
+  const std::string* request_header(const char* name) const;
   void on_headers_received(const boost::system::error_code& ec, std::size_t bytes_transferred);
+  // the Content-Length body is in m_requested_query_string
+  void on_body_received(const boost::system::error_code& ec, std::size_t bytes_transferred);
+  // false: no route, or refused. m_offloaded: the handler was queued on handler_executor
   bool process_request_router();
+  bool process_request_handler(::cb::library::RouterHttp::method_t handler, ::cb::library::RouterHttp::writer_t writer);
+  // a handler's string as the body
+  void process_request_result(std::string& res);
+  // a cached body, NULL when the request it waited for failed (503)
+  void process_request_cached(const ::cb::library::ResponseCache::value_t& value);
   bool process_request_static();
+  // status line and headers for a body of len bytes (chunked: Transfer-Encoding instead of Content-Length)
+  void head(std::size_t len, bool chunked);
+  // the writer's pending segments as a chunk, into m_response_buffers
+  void chunk();
+  // a writer_t route's head / chunk, written before the handler returned
+  bool emit(std::size_t& bytes);
+  // nsec since the request reached the host, the accept backlog included where the kernel tells
+  unsigned long long sojourn();
   void send_response();
   void on_response_sent(const boost::system::error_code& ec, std::size_t bytes_transferred);
   void on_finish();
+  // drops a hold on the service, the last one recycles it
+  void release();
+  void log_access(std::size_t bytes_out);
 
  private:
-  std::shared_ptr<boost::asio::ip::tcp::socket> m_sock;
+  ServerHttpBoostAcceptor* m_owner;
+  // the socket's handlers and the idle timer's run one at a time (on_idle shuts the socket down under a pending read)
+  boost::asio::strand<boost::asio::io_service::executor_type> m_strand;
+  boost::asio::ip::tcp::socket m_sock;
   boost::asio::streambuf m_request;
-  std::map<std::string, std::string> m_request_headers;
+  // name, value: the first m_request_headers_size in use, the rest kept with their strings for the next request
+  std::vector<std::pair<std::string, std::string>> m_request_headers;
+  std::size_t m_request_headers_size;
   std::string m_requested_resource, m_requested_query_string;
-  std::unique_ptr<char[]> m_resource_buffer;
+  std::string m_resource_buffer;
   unsigned int m_response_status_code;
   std::size_t m_resource_size_bytes;
   std::string m_response_headers;
   std::string m_response_status_line;
+  std::vector<boost::asio::const_buffer> m_response_buffers;
+  ServerHttpBoostWriter m_writer;
+  bool m_streamed; // answered by a writer_t route
+  bool m_offloaded; // send_response() comes later, from handler_executor, a coroutine or response_cache
+  std::string m_cache_key; // the handler's result goes to response_cache
+  unsigned int m_cache_ttl;
+  ::cb::library::ResponseCache::value_t m_cached; // the body, instead of m_resource_buffer
+  char m_chunk[24]; // chunk size line
+  bool m_admitted; // holds a slot of admission's
+  std::atomic<unsigned int>* m_route_slot; // and of the route's
+  boost::asio::steady_timer m_idle; // ends a connection that waits too long for its next request
+  std::atomic<unsigned int> m_waiting; // the request the timer may cut, 0: none (it came in)
+  std::atomic<unsigned int> m_holds; // the connection and the armed timer, whichever is done last recycles
+  unsigned int m_served; // requests on the connection
+  bool m_keep_alive; // after this response
+  unsigned short m_allow; // a 405's Allow, RouterHttp::tagMatch::methods
 
   bool m_recv;
 
+  boost::asio::ip::tcp::endpoint m_endpoint;
   ::cb::common::types::HttpRequest m_req;
+
+  // access log
+  std::size_t m_bytes_in;
+  unsigned long long m_accepted; // utmilli
+  unsigned long long m_t_accepted, m_t_read, m_t_handled; // times::monotonic
 };
 
 const std::map<unsigned int, std::string> ServerHttpBoostService::http_status_table = {
   { 200, "200 OK" },
+  { 201, "201 Created" },
+  { 202, "202 Accepted" },
+  { 204, "204 No Content" },
+  { 301, "301 Moved Permanently" },
+  { 302, "302 Found" },
+  { 304, "304 Not Modified" },
   { 400, "400 Bad Request" },
   { 403, "403 Forbidden" },
   { 404, "404 Not Found" },
+  { 405, "405 Method Not Allowed" },
   { 408, "408 Request Timeout" },
   { 413, "413 Request Entity Too Large" },
+  { 429, "429 Too Many Requests" },
   { 500, "500 Server Error" },
   { 501, "501 Not Implemented" },
+  { 503, "503 Service Unavailable" },
   { 504, "504 Gateway Timeout" },
   { 505, "505 HTTP Version Not Supported" }
 };
@@ -94,14 +274,29 @@ class ServerHttpBoostAcceptor {
   void start();
   void stop();
 
+  // a reset service from the calling thread's free list, a new one when it's empty
+  ServerHttpBoostService* obtain();
+  void recycle(ServerHttpBoostService* service);
+
  private:
   void initAccept();
-  void onAccept(const boost::system::error_code& ec, std::shared_ptr<boost::asio::ip::tcp::socket> sock);
+  void onAccept(const boost::system::error_code& ec, ServerHttpBoostService* service);
+
+ private:
+  // one per thread (modulo), so they hardly ever contend
+  typedef struct {
+    std::mutex mtx;
+    std::vector<ServerHttpBoostService*> services;
+  } tagFreeList;
+
+  tagFreeList& freeList();
 
  private:
   boost::asio::io_service& m_ios;
   boost::asio::ip::tcp::acceptor m_acceptor;
   std::atomic<bool> m_isStopped;
+  std::vector<std::unique_ptr<tagFreeList>> m_free;
+  ServerHttpBoostService* m_accepting; // given to the pending async_accept
 };
 
 } // namespace
@@ -113,11 +308,28 @@ class ServerHttpBoostAcceptor {
     boost::asio::ip::tcp::endpoint(
       boost::asio::ip::address_v4::any(),
       port_num)),
-  m_isStopped(false)
-{}
+  m_isStopped(false),
+  m_accepting(NULL)
+{
+  unsigned int shards = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
 
-::ServerHttpBoostAcceptor::~ServerHttpBoostAcceptor()
-{}
+  for (unsigned int i = 0; i < shards; ++i) {
+    m_free.emplace_back(new tagFreeList);
+  }
+}
+
+::ServerHttpBoostAcceptor::~ServerHttpBoostAcceptor() {
+  boost::system::error_code errcode;
+
+  // the io_service has stopped: an accept still pending won't complete
+  m_acceptor.close(errcode);
+  delete m_accepting;
+  for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+    for (auto service = (*it)->services.begin(); service != (*it)->services.end(); ++service) {
+      delete *service;
+    }
+  }
+}
 
 // Start accepting incoming connection requests.
 void ::ServerHttpBoostAcceptor::start() {
@@ -130,23 +342,62 @@ void ::ServerHttpBoostAcceptor::stop() {
   m_isStopped.store(true);
 }
 
+::ServerHttpBoostAcceptor::tagFreeList& ::ServerHttpBoostAcceptor::freeList() {
+  static std::atomic<unsigned int> next(0);
+  static thread_local unsigned int id = next.fetch_add(1, std::memory_order_relaxed);
+
+  return *m_free[id % m_free.size()];
+}
+
+::ServerHttpBoostService* ::ServerHttpBoostAcceptor::obtain() {
+  tagFreeList& list = freeList();
+  ::ServerHttpBoostService* rtn = NULL;
+
+  {
+    std::lock_guard<std::mutex> guard(list.mtx);
+    if (list.services.empty() == false) {
+      rtn = list.services.back();
+      list.services.pop_back();
+    }
+  }
+
+  return (rtn != NULL) ? rtn : new ::ServerHttpBoostService(m_ios, this);
+}
+
+void ::ServerHttpBoostAcceptor::recycle(::ServerHttpBoostService* service) {
+  tagFreeList& list = freeList();
+
+  service->reset();
+  {
+    std::lock_guard<std::mutex> guard(list.mtx);
+    if (list.services.size() < CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_FREE) {
+      list.services.push_back(service);
+      return;
+    }
+  }
+
+  // a burst is over, more than the list keeps
+  delete service;
+}
+
 void ::ServerHttpBoostAcceptor::initAccept() {
-  std::shared_ptr<boost::asio::ip::tcp::socket> sock(new boost::asio::ip::tcp::socket(m_ios));
+  ::ServerHttpBoostService* service = obtain();
+  m_accepting = service;
   //m_acceptor.set_option(boost::asio::socket_base::keep_alive(true));
-  m_acceptor.async_accept(*sock.get(), [this, sock](const boost::system::error_code& error) {
-    onAccept(error, sock);
+  m_acceptor.async_accept(service->socket(), [this, service](const boost::system::error_code& error) {
+    onAccept(error, service);
   });
 }
 
-void ::ServerHttpBoostAcceptor::onAccept(const boost::system::error_code& ec, std::shared_ptr<boost::asio::ip::tcp::socket> sock) {
+void ::ServerHttpBoostAcceptor::onAccept(const boost::system::error_code& ec, ::ServerHttpBoostService* service) {
+  m_accepting = NULL;
   if (ec == boost::system::errc::success) {
     //boost::asio::socket_base::keep_alive option(true);
-    //sock->set_option(option);
-    (new ::ServerHttpBoostService(sock))->start_handling();
+    //service->socket().set_option(option);
+    service->start_handling();
   } else {
-    std::ostringstream oss;
-    oss << __FUNCTION__ << ":" << __LINE__ << ": " << "Error occured! Error code = " << ec.value() << ". Message: " << ec.message();
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
+    recycle(service);
 
     return;
   }
@@ -163,46 +414,158 @@ void ::ServerHttpBoostAcceptor::onAccept(const boost::system::error_code& ec, st
 }
 
 // ---------------------------------------------------- ServerHttpBoostService
-::ServerHttpBoostService::ServerHttpBoostService(std::shared_ptr<boost::asio::ip::tcp::socket> sock) :
-  m_sock(sock),
+::ServerHttpBoostService::ServerHttpBoostService(boost::asio::io_service& ios, ::ServerHttpBoostAcceptor* owner) :
+  m_owner(owner),
+  m_strand(boost::asio::make_strand(ios)),
+  m_sock(m_strand),
   m_request(4096),
+  m_request_headers_size(0),
   m_response_status_code(200), // Assume success.
   m_resource_size_bytes(0),
-  m_recv(false)
-{
-  // for remote_endpoint: Transport endpoint is not connected
+  m_writer(this),
+  m_streamed(false),
+  m_offloaded(false),
+  m_cache_ttl(0),
+  m_admitted(false),
+  m_route_slot(NULL),
+  m_idle(m_strand),
+  m_waiting(0),
+  m_holds(0),
+  m_served(0),
+  m_keep_alive(false),
+  m_allow(0),
+  m_recv(false),
+  m_bytes_in(0),
+  m_accepted(0),
+  m_t_accepted(0),
+  m_t_read(0),
+  m_t_handled(0)
+{}
+
+::ServerHttpBoostService::~ServerHttpBoostService()
+{}
+
+boost::asio::ip::tcp::socket& ::ServerHttpBoostService::socket() {
+  return m_sock;
+}
+
+void ::ServerHttpBoostService::reset() {
   boost::system::error_code errcode;
-  boost::asio::ip::tcp::endpoint endpoint = m_sock.get()->remote_endpoint(errcode);
 
-  if (errcode == boost::system::errc::success) {
-    m_req.remote_addr = endpoint.address().to_string();
-    m_req.remote_port = endpoint.port();
-  }
+  m_sock.close(errcode);
+  m_request.consume(m_request.size());
+  m_waiting.store(0);
+  m_served = 0;
+  m_endpoint = boost::asio::ip::tcp::endpoint();
+  retain(m_req.remote_addr);
+  m_req.remote_port = 0;
+
+  reset_request();
 }
 
-::ServerHttpBoostService::~ServerHttpBoostService()
-{}
+void ::ServerHttpBoostService::reset_request() {
+  for (std::size_t i = 0; i < m_request_headers_size; ++i) {
+    retain(m_request_headers[i].first);
+    retain(m_request_headers[i].second);
+  }
+  m_request_headers_size = 0;
+  retain(m_requested_resource);
+  retain(m_requested_query_string);
+  retain(m_resource_buffer);
+  m_response_status_code = 200;
+  m_resource_size_bytes = 0;
+  retain(m_response_headers);
+  retain(m_response_status_line);
+  retain(m_response_buffers);
+  m_writer.clear();
+  m_streamed = false;
+  m_offloaded = false;
+  retain(m_cache_key);
+  m_cache_ttl = 0;
+  m_cached.reset();
+  if (m_admitted == true) {
+    admission->leave(m_route_slot);
+    admission->release();
+  }
+  m_admitted = false;
+  m_route_slot = NULL;
+  m_keep_alive = false;
+  m_allow = 0;
+  m_recv = false;
+
+  retain(m_req.method);
+  retain(m_req.path);
+  m_req.params.clear();
+
+  m_bytes_in = 0;
+  m_accepted = 0;
+  m_t_accepted = 0;
+  m_t_read = 0;
+  m_t_handled = 0;
+}
 
 void ::ServerHttpBoostService::start_handling() {
   boost::system::error_code errcode;
-  boost::asio::ip::tcp::endpoint endpoint = m_sock.get()->remote_endpoint(errcode);
+  boost::asio::ip::tcp::endpoint endpoint = m_sock.remote_endpoint(errcode);
+
+  m_holds.store(1);
+  m_accepted = ::cb::common::times::unixtimemillicoarse();
+  m_t_accepted = ::cb::common::times::monotonic();
 
   if (errcode != boost::system::errc::success) {
     // remote_endpoint: Transport endpoint is not connected
     return on_finish();
   }
+  m_endpoint = endpoint;
+  m_req.remote_addr = endpoint.address().to_string();
+  m_req.remote_port = endpoint.port();
+
+  read_request();
+}
+
+void ::ServerHttpBoostService::read_request() {
+  if (keep_alive_timeout > 0) {
+    // numbered, so that a timer that fired for an earlier request can't cut this one
+    unsigned int waiting = m_served + 1;
+
+    m_waiting.store(waiting);
+    m_holds.fetch_add(1);
+    m_idle.expires_after(std::chrono::milliseconds(keep_alive_timeout));
+    m_idle.async_wait([this, waiting](const boost::system::error_code& ec) {
+      on_idle(ec, waiting);
+    });
+  }
 
-  boost::asio::async_read_until(*m_sock.get(), m_request, delim_line_each, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+  boost::asio::async_read_until(m_sock, m_request, delim_line_each, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
     on_request_line_received(ec, bytes_transferred);
   });
 }
 
+void ::ServerHttpBoostService::on_idle(const boost::system::error_code& ec, unsigned int waiting) {
+  if (ec != boost::asio::error::operation_aborted && m_waiting.compare_exchange_strong(waiting, 0) == true) {
+    boost::system::error_code errcode;
+
+    // the pending read ends (eof), and the connection with it
+    m_sock.shutdown(boost::asio::ip::tcp::socket::shutdown_both, errcode);
+  }
+
+  release();
+}
+
 void ::ServerHttpBoostService::on_request_line_received(const boost::system::error_code& ec, std::size_t bytes_transferred) {
-  std::ostringstream oss;
+  // the idle timer has nothing left to cut
+  m_waiting.store(0);
+  m_idle.cancel();
 
   if (ec != boost::system::errc::success) {
-    oss << __FUNCTION__ << ":" << __LINE__ << ": " << "Error occured! Error code = " << ec.value() << ". Message: " << ec.message();
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+    if (ec == boost::asio::error::eof && m_served > 0) {
+      // the client closed its idle connection, or the timer did
+      CB_LOGF_DEBUG("closed: {} after {} requests", m_endpoint, m_served);
+
+      return on_finish();
+    }
+
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
 
     if (ec == boost::asio::error::not_found) {
       // No delimiter has been found in the
@@ -220,29 +583,38 @@ void ::ServerHttpBoostService::on_request_line_received(const boost::system::err
     }
   }
 
-  //auto bufs = m_request.data();
-  //std::string result(buffers_begin(bufs), buffers_begin(bufs) + m_request.size());
-  //oss.str(""); oss.clear();
-  //oss << "\n---------------------------- base info\n" << result << "---------------------------- base info";
-  //::cb::common::Logger::log(::cb::common::Logger::eLevel::eDebug, "%s", oss.str().c_str());
+  if (bytes_transferred == delim_line_each.size() && m_served > 0) {
+    // a blank line between pipelined requests (e.g. after a body)
+    m_request.consume(bytes_transferred);
 
-  // Parse the request line.
-  std::string request_line;
-  std::istream request_stream(&m_request);
-  std::getline(request_stream, request_line, '\r');
-  // Remove symbol '\n' from the buffer.
-  request_stream.get();
-  // Parse the request line.
-  std::istringstream request_line_stream(request_line);
-  request_line_stream >> m_req.method;
-
-  request_line_stream >> m_requested_resource;
+    return read_request();
+  }
 
-  std::string request_http_version;
-  request_line_stream >> request_http_version;
+  if (++m_served > 1) {
+    // the first one counts from the accept, the next ones from their request line
+    m_accepted = ::cb::common::times::unixtimemillicoarse();
+    m_t_accepted = ::cb::common::times::monotonic();
+  }
 
-  // We only support GET, POST method.
-  if (m_req.method.compare("GET") != 0 && m_req.method.compare("POST") != 0) {
+  // Parse the request line where it was read. Its CRLF stays in the buffer,
+  // the headers are read up to the blank line after it.
+  const char* pos = static_cast<const char*>(m_request.data().data());
+  const char* end = pos + (bytes_transferred - delim_line_each.size());
+  const char* first = NULL;
+  std::size_t len;
+
+  len = token(pos, end, first);
+  m_req.method.assign(first, len);
+  len = token(pos, end, first);
+  m_requested_resource.assign(first, len);
+  len = token(pos, end, first);
+  bool http11 = (len == 8 && memcmp(first, "HTTP/1.1", 8) == 0);
+
+  m_request.consume(bytes_transferred - delim_line_each.size());
+  m_bytes_in = bytes_transferred - delim_line_each.size();
+
+  // Methods the router can dispatch on.
+  if (::cb::library::RouterHttp::toMethod(m_req.method) == ::cb::library::RouterHttp::eMethod::eAny) {
     // Unsupported method.
     m_response_status_code = 501;
     send_response();
@@ -250,7 +622,7 @@ void ::ServerHttpBoostService::on_request_line_received(const boost::system::err
     return;
   }
 
-  if (request_http_version.compare("HTTP/1.1") != 0) {
+  if (http11 == false) {
     // Unsupported HTTP version or bad request.
     m_response_status_code = 505;
     send_response();
@@ -260,19 +632,74 @@ void ::ServerHttpBoostService::on_request_line_received(const boost::system::err
 
   // At this point the request line is successfully
   // received and parsed. Now read the request headers.
-  boost::asio::async_read_until(*m_sock.get(), m_request, delim_line_section, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+  boost::asio::async_read_until(m_sock, m_request, delim_line_section, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
     on_headers_received(ec, bytes_transferred);
   });
 
   return;
 }
 
-void ::ServerHttpBoostService::on_headers_received(const boost::system::error_code& ec, std::size_t bytes_transferred) {
-  std::ostringstream oss;
+void ::ServerHttpBoostService::parse_headers(std::size_t bytes) {
+  // parsed where it was read, into the strings kept from the previous requests
+  const char* block = static_cast<const char*>(m_request.data().data());
+  const char* block_end = block + bytes;
+  const char* pos = block + delim_line_each.size();
+  const char* end;
+
+  // CRLF name: value CRLF ... CRLF CRLF
+  while ((end = std::search(pos, block_end, delim_line_each.begin(), delim_line_each.end())) != block_end && end > pos) {
+    const char* colon = std::find(pos, end, ':');
+    if (colon != end) {
+      const char* first = colon + 1;
+      const char* last = end;
+      std::size_t i = 0;
+
+      while (first < last && (*first == ' ' || *first == '\t')) {
+        ++first;
+      }
+      while (last > first && (last[-1] == ' ' || last[-1] == '\t')) {
+        --last;
+      }
 
+      for (; i < m_request_headers_size; ++i) {
+        const std::string& name = m_request_headers[i].first;
+        if (name.size() == static_cast<std::size_t>(colon - pos) &&
+          std::equal(pos, colon, name.begin(), [](char lhs, char rhs) { return ::tolower(static_cast<unsigned char>(lhs)) == rhs; }) == true) {
+          break;
+        }
+      }
+      if (i == m_request_headers_size) {
+        if (m_request_headers_size == m_request_headers.size()) {
+          m_request_headers.emplace_back();
+        }
+        std::string& name = m_request_headers[m_request_headers_size++].first;
+        name.assign(pos, colon);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+      } else {
+        // repeated: one list
+        m_request_headers[i].second.append(", ");
+      }
+      m_request_headers[i].second.append(first, last);
+    }
+    pos = end + delim_line_each.size();
+  }
+
+  m_request.consume(bytes);
+}
+
+const std::string* ::ServerHttpBoostService::request_header(const char* name) const {
+  for (std::size_t i = 0; i < m_request_headers_size; ++i) {
+    if (m_request_headers[i].first == name) {
+      return &m_request_headers[i].second;
+    }
+  }
+
+  return NULL;
+}
+
+void ::ServerHttpBoostService::on_headers_received(const boost::system::error_code& ec, std::size_t bytes_transferred) {
   if (ec != boost::system::errc::success) {
-    oss << __FUNCTION__ << ":" << __LINE__ << ": " << "Error occured! Error code = " << ec.value() << ". Message: " << ec.message();
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
 
     if (ec == boost::asio::error::not_found) {
       // No delimiter has been fonud in the
@@ -290,6 +717,10 @@ void ::ServerHttpBoostService::on_headers_received(const boost::system::error_co
     }
   }
 
+  m_t_read = ::cb::common::times::monotonic();
+  m_bytes_in += bytes_transferred;
+  parse_headers(bytes_transferred);
+
   std::size_t isquery = m_requested_resource.find('?');
   if (isquery == std::string::npos) {
     m_req.path = m_requested_resource;
@@ -297,27 +728,104 @@ void ::ServerHttpBoostService::on_headers_received(const boost::system::error_co
     m_req.path = m_requested_resource.substr(0, isquery);
   }
 
-  if (m_req.method == "GET") {
-    if (isquery != std::string::npos) {
-      m_requested_query_string = m_requested_resource.substr(isquery + 1);
+  // HTTP/1.1 keeps the connection unless the client says otherwise
+  const std::string* connection = request_header("connection");
+  m_keep_alive = (keep_alive_timeout > 0 && m_served < keep_alive_requests);
+  if (connection != NULL) {
+    static const char token_close[] = "close";
+    auto close = std::search(connection->begin(), connection->end(), token_close, token_close + 5, [](char lhs, char rhs) {
+      return ::tolower(static_cast<unsigned char>(lhs)) == rhs;
+    });
+    if (close != connection->end()) {
+      m_keep_alive = false;
+    }
+  }
+
+  if (admission.get() != nullptr) {
+    ::cb::library::AdmissionControl::eVerdict verdict = admission->admit(m_req.remote_addr, sojourn());
+
+    if (verdict != ::cb::library::AdmissionControl::eVerdict::eAdmit) {
+      // refused before the body is read and the params parsed. the connection goes too
+      m_response_status_code = (verdict == ::cb::library::AdmissionControl::eVerdict::eLimited) ? 429 : 503;
+      m_keep_alive = false;
+      send_response();
+
+      return;
     }
+    m_admitted = true;
+  }
+
+  // the body, to its Content-Length: the next request may follow it
+  std::size_t length = 0;
+  if (request_header("transfer-encoding") != NULL) {
+    // not read chunk by chunk: whatever came with the headers, and the connection ends there
+    length = m_request.size();
+    m_keep_alive = false;
   } else {
-    auto param = m_request.data();
-    std::string result(buffers_begin(param), buffers_begin(param) + m_request.size());
-    std::size_t params_start = result.find(delim_line_section);
-    if (params_start != std::string::npos) {
-      m_requested_query_string = result.substr(params_start + delim_line_section.size());
+    const std::string* content_length = request_header("content-length");
+    if (content_length != NULL) {
+      char* end = NULL;
+      unsigned long long value = strtoull(content_length->c_str(), &end, 10);
+
+      if (content_length->empty() == true || *end != '\0' || (*content_length)[0] == '-') {
+        m_response_status_code = 400;
+        m_keep_alive = false;
+        send_response();
+
+        return;
+      }
+      if (value > CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_BODY) {
+        m_response_status_code = 413;
+        m_keep_alive = false;
+        send_response();
+
+        return;
+      }
+      length = static_cast<std::size_t>(value);
     }
   }
 
-  oss.str(""); oss.clear();
-  oss << "recv: {\"method\": \"" << m_req.method << "\", \"path\": \"" << m_req.path << "\", \"params\": \"" << m_requested_query_string << "\"}";
-  ::cb::common::Logger::log(::cb::common::Logger::eLevel::eInfo, "%s", oss.str().c_str());
+  std::size_t buffered = std::min(length, m_request.size());
+  auto body = m_request.data();
+  m_requested_query_string.assign(buffers_begin(body), buffers_begin(body) + buffered);
+  m_request.consume(buffered);
+  if (buffered < length) {
+    m_requested_query_string.resize(length);
+    boost::asio::async_read(m_sock, boost::asio::buffer(&m_requested_query_string[buffered], length - buffered), [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+      on_body_received(ec, bytes_transferred);
+    });
 
-  if (m_requested_query_string.empty() == false) {
+    return;
+  }
+
+  on_body_received(boost::system::error_code(), 0);
+}
+
+void ::ServerHttpBoostService::on_body_received(const boost::system::error_code& ec, std::size_t bytes_transferred) {
+  (void)bytes_transferred;
+
+  if (ec != boost::system::errc::success) {
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
+
+    return on_finish();
+  }
+
+  m_bytes_in += m_requested_query_string.size();
+
+  std::size_t isquery = m_requested_resource.find('?');
+  std::string query = (isquery != std::string::npos) ? m_requested_resource.substr(isquery + 1) : std::string();
+  // a body that came with a GET or HEAD is dropped
+  if (m_req.method == "GET" || m_req.method == "HEAD") {
+    m_requested_query_string.clear();
+  }
+
+  CB_LOGF_DEBUG("recv: {} {{\"method\": \"{}\", \"path\": \"{}\", \"params\": \"{}\", \"body\": \"{}\"}}", m_endpoint, m_req.method, m_req.path, query, m_requested_query_string);
+
+  // the url's query for every method, the body's params over it
+  auto parse = [this](const std::string& params) {
     std::string k, v;
     std::size_t t;
-    std::istringstream iss(m_requested_query_string);
+    std::istringstream iss(params);
     for (std::string token; std::getline(iss, token, '&'); ) {
 
       v = std::move(token);
@@ -333,60 +841,244 @@ void ::ServerHttpBoostService::on_headers_received(const boost::system::error_co
         m_req.params[k] = v;
       }
     }
+  };
+  if (query.empty() == false) {
+    parse(query);
+  }
+  if (m_requested_query_string.empty() == false) {
+    parse(m_requested_query_string);
   }
 
   // static first
   if (process_request_static() == false || m_response_status_code != 200) {
     // router second
     process_request_router();
+    if (m_offloaded == true) {
+      // back on the io thread once the handler returns
+      return;
+    }
   }
   send_response();
 }
 
 bool ::ServerHttpBoostService::process_request_router() {
-  bool rtn = false;
+  ::cb::library::RouterHttp::tagMatch match;
+
+  match.handler = NULL;
+  match.writer = NULL;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+  match.coroutine = NULL;
+#endif
+  match.offload = false;
+  match.cache = 0;
+  match.path = false;
+  match.methods = 0;
+
+  const ::cb::library::IRouterHttpStatic* router_static = service_router_static.load(std::memory_order_acquire);
+  unsigned short methods_static = 0;
+  if (router_static != NULL) {
+    match.handler = router_static->find(m_req.path.data(), m_req.path.size(), ::cb::library::RouterHttp::toMethod(m_req.method), methods_static);
+  }
+  if (match.handler == NULL) {
+    // the captures point into the table: copied before the guard lets it go
+    ::cb::common::Rcu<::cb::library::RouterHttp>::Guard router(service_router);
+    router->match(m_req.method, m_req.path, match);
+    ::cb::library::RouterHttp::capture(m_req.path, match, m_req);
+    // a static path without the method is a 405 too, its methods in the Allow
+    match.methods |= methods_static;
+    match.path = (match.methods != 0);
+  }
 
-  std::ostringstream oss;
-  std::string res;
+  if (m_admitted == true && admission->enter(route(match), m_route_slot) == false) {
+    m_response_status_code = 503;
 
-  if (service_router.routes().find(m_req.path) == service_router.routes().end()) {
-    m_response_status_code = 404;
+    CB_LOGF_WARN("route busy: {} {}", m_req.method, m_req.path);
 
-    oss.str(""); oss.clear();
-    oss << "doesn't exist key in map: " << m_req.path;
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eWarn, "%s", oss.str().c_str());
+    return false;
+  }
 
-    return rtn;
-  } else {
-    try {
-      m_response_status_code = 200;
+#if defined(CB_LIBRARY_ROUTER_HTTP_HPP_COROUTINE)
+  if (match.coroutine != NULL) {
+    m_offloaded = true;
+    boost::asio::co_spawn(m_sock.get_executor(), match.coroutine(m_req), [this](std::exception_ptr err, std::string res) {
+      if (err == nullptr) {
+        m_response_status_code = 200;
+        process_request_result(res);
+      } else {
+        m_response_status_code = 500;
+        try {
+          std::rethrow_exception(err);
+        } catch (std::exception& e) {
+          CB_LOGF_ERROR("{}:{}: {}", __FUNCTION__, __LINE__, e.what());
+        } catch (...) {
+        }
+      }
+      send_response();
+    });
+
+    return true;
+  }
+#endif
+
+  if (match.handler == NULL && match.writer == NULL) {
+    m_response_status_code = (match.path == true) ? 405 : 404;
+    m_allow = match.methods;
+
+    CB_LOGF_WARN("no route for: {} {}", m_req.method, m_req.path);
+
+    return false;
+  }
+
+  if (match.cache > 0 && match.handler != NULL && response_cache.get() != nullptr &&
+    (m_req.method == "GET" || m_req.method == "HEAD")) {
+    ::cb::library::ResponseCache::value_t value;
+    ::cb::library::ResponseCache::eLookup found;
+
+    m_cache_key = ::cb::library::ResponseCache::key(m_req.method, m_req.path, m_req.params);
+    found = response_cache->lookup(m_cache_key, value, [this](const ::cb::library::ResponseCache::value_t& cached) {
+      boost::asio::post(m_sock.get_executor(), [this, cached]() {
+        process_request_cached(cached);
+        send_response();
+      });
+    });
+    if (found != ::cb::library::ResponseCache::eLookup::eMiss) {
+      m_cache_key.clear();
+      if (found == ::cb::library::ResponseCache::eLookup::eHit) {
+        process_request_cached(value);
+      } else {
+        // another request runs the handler
+        m_offloaded = true;
+      }
+
+      return true;
+    }
+    m_cache_ttl = match.cache;
+  }
+
+  if (match.writer != NULL && handler_executor.get() == nullptr) {
+    // its flushes would block the io thread
+    m_response_status_code = 500;
+
+    CB_LOGF_ERROR("writer route without a handler executor: {} {}", m_req.method, m_req.path);
+
+    return false;
+  }
 
-      res = service_router.route(m_req.path)(m_req);
+  if (match.offload == true && handler_executor.get() != nullptr) {
+    ::cb::library::RouterHttp::method_t handler = match.handler;
+    ::cb::library::RouterHttp::writer_t writer = match.writer;
+    unsigned long long posted = ::cb::common::times::monotonic();
+
+    offloaded.fetch_add(1);
+    m_offloaded = handler_executor->post([this, handler, writer, posted]() {
+      if (m_admitted == true && admission->shed(::cb::common::times::monotonic() - posted) == true) {
+        // waited too long in the queue, the client is better off with a 503 now
+        m_response_status_code = 503;
+        if (m_cache_key.empty() == false) {
+          response_cache->fail(m_cache_key);
+        }
+      } else {
+        process_request_handler(handler, writer);
+      }
+      boost::asio::post(m_sock.get_executor(), [this]() {
+        send_response();
+        offloaded.fetch_sub(1);
+      });
+    });
+    if (m_offloaded == false) {
+      offloaded.fetch_sub(1);
+      m_response_status_code = 503;
+      if (m_cache_key.empty() == false) {
+        response_cache->fail(m_cache_key);
+      }
+
+      CB_LOGF_WARN("handler queue full: {} {}", m_req.method, m_req.path);
+    }
+
+    return m_offloaded;
+  }
+
+  return process_request_handler(match.handler, match.writer);
+}
+
+bool ::ServerHttpBoostService::process_request_handler(::cb::library::RouterHttp::method_t handler, ::cb::library::RouterHttp::writer_t writer) {
+  bool rtn = false;
+
+  std::string res;
+
+  if (writer != NULL) {
+    m_streamed = true;
+    try {
+      writer(m_req, m_writer);
       rtn = true;
     } catch (std::exception& err) {
-      m_response_status_code = 500;
+      CB_LOGF_ERROR("{}:{}: {}", __FUNCTION__, __LINE__, err.what());
 
-      oss.str(""); oss.clear();
-      oss << __FUNCTION__ << ":" << __LINE__ << ": " << err.what();
-      ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+      if (m_writer.chunked() == true) {
+        // the head is out: the client sees the response cut short
+        m_writer.abort();
+      } else {
+        m_streamed = false;
+        m_writer.consume();
+        m_response_status_code = 500;
 
-      return rtn;
+        return rtn;
+      }
     }
+    m_response_status_code = m_writer.code();
+
+    CB_LOGF_DEBUG("send: {} ({} + {} bytes)", m_req.path, m_writer.sent(), m_writer.size());
+
+    return rtn;
   }
 
-  m_resource_size_bytes = static_cast<std::size_t>(res.size());
-  char* c_str = new char[m_resource_size_bytes + 1];
-  std::copy(res.begin(), res.end(), c_str);
-  c_str[m_resource_size_bytes] = '\0';
-  m_resource_buffer.reset(c_str);
+  try {
+    m_response_status_code = 200;
+
+    res = handler(m_req);
+    rtn = true;
+  } catch (std::exception& err) {
+    m_response_status_code = 500;
+    if (m_cache_key.empty() == false) {
+      response_cache->fail(m_cache_key);
+    }
 
-  ::cb::common::Logger::log(::cb::common::Logger::eLevel::eInfo, "send: %s", c_str);
+    CB_LOGF_ERROR("{}:{}: {}", __FUNCTION__, __LINE__, err.what());
+
+    return rtn;
+  }
+  if (m_cache_key.empty() == false) {
+    process_request_cached(response_cache->put(m_cache_key, std::move(res), m_cache_ttl));
+  } else {
+    process_request_result(res);
+  }
 
   //std::ifstream::{app, ate, binary, in, out, trunc}
 
   return rtn;
 }
 
+void ::ServerHttpBoostService::process_request_result(std::string& res) {
+  m_resource_size_bytes = static_cast<std::size_t>(res.size());
+  m_resource_buffer.swap(res);
+
+  CB_LOGF_DEBUG("send: {} ({} bytes)", m_req.path, m_resource_size_bytes);
+}
+
+void ::ServerHttpBoostService::process_request_cached(const ::cb::library::ResponseCache::value_t& value) {
+  if (value.get() == nullptr) {
+    m_response_status_code = 503;
+
+    return;
+  }
+
+  m_response_status_code = 200;
+  m_cached = value;
+  m_resource_size_bytes = value->size();
+
+  CB_LOGF_DEBUG("send: {} ({} bytes, cached)", m_req.path, m_resource_size_bytes);
+}
+
 bool ::ServerHttpBoostService::process_request_static() {
   bool rtn = false;
 
@@ -425,88 +1117,237 @@ bool ::ServerHttpBoostService::process_request_static() {
   // Find out file size.
   resource_fstream.seekg(0, std::ifstream::end);
   m_resource_size_bytes = static_cast<std::size_t>(resource_fstream.tellg());
-  m_resource_buffer.reset(new char[m_resource_size_bytes]);
+  m_resource_buffer.resize(m_resource_size_bytes);
   resource_fstream.seekg(std::ifstream::beg);
-  resource_fstream.read(m_resource_buffer.get(), m_resource_size_bytes);
+  resource_fstream.read(&m_resource_buffer[0], m_resource_size_bytes);
 
-  ::cb::common::Logger::log(::cb::common::Logger::eLevel::eInfo, "send: %s", m_req.path.c_str());
+  CB_LOGF_DEBUG("send: {} ({} bytes)", m_req.path, m_resource_size_bytes);
 
   return rtn;
 }
 
+void ::ServerHttpBoostService::head(std::size_t len, bool chunked) {
+  char date[CB_DEFINES_H_LEN_HTTPDATE];
+  ::cb::common::times::httpdatecoarse(date);
+
+  if (m_keep_alive == true) {
+    m_response_headers += std::string("Connection: keep-alive").append(delim_line_each);
+    m_response_headers += std::string("Keep-Alive: timeout=") + std::to_string((keep_alive_timeout + 999) / 1000) +
+      ", max=" + std::to_string(keep_alive_requests - m_served) + delim_line_each;
+  } else {
+    m_response_headers += std::string("Connection: close").append(delim_line_each);
+  }
+  m_response_headers += std::string("Date: ").append(date).append(delim_line_each);
+  if (m_streamed == false || m_writer.typed() == false) {
+    m_response_headers += std::string("Content-Type: text/html; charset=utf-8").append(delim_line_each);
+  }
+  if (chunked == true) {
+    m_response_headers += std::string("Transfer-Encoding: chunked").append(delim_line_each);
+  } else {
+    m_response_headers += std::string("Content-Length: ") + std::to_string(len).append(delim_line_each);
+  }
+  m_response_headers += std::string("Server: Boost.Asio").append(delim_line_each);
+  if (m_response_status_code == 405 && m_allow != 0) {
+    m_response_headers += "Allow: ";
+    ::cb::library::RouterHttp::allow(m_allow, m_response_headers);
+    m_response_headers += delim_line_each;
+  }
+  if (m_streamed == true) {
+    m_response_headers += m_writer.headers();
+  }
+
+  // a status the table lacks (from a writer_t route) goes out as a bare code
+  auto status_line = http_status_table.find(m_response_status_code);
+  m_response_status_line = std::string("HTTP/1.1 ");
+  if (status_line != http_status_table.end()) {
+    m_response_status_line += status_line->second;
+  } else {
+    m_response_status_line += std::to_string(m_response_status_code) + " ";
+  }
+  m_response_status_line += delim_line_each;
+  m_response_headers += delim_line_each;
+}
+
+void ::ServerHttpBoostService::chunk() {
+  // an empty chunk would end the body. HEAD: the head alone, what the writer flushes is dropped
+  if (m_writer.size() == 0 || m_req.method == "HEAD") {
+    return;
+  }
+
+  int len = snprintf(m_chunk, sizeof(m_chunk), "%zx\r\n", m_writer.size());
+  m_response_buffers.push_back(boost::asio::buffer(m_chunk, static_cast<std::size_t>(len)));
+  for (auto it = m_writer.segments().begin(); it != m_writer.segments().end(); ++it) {
+    m_response_buffers.push_back(boost::asio::buffer(it->data, it->len));
+  }
+  m_response_buffers.push_back(boost::asio::buffer(delim_line_each));
+}
+
+bool ::ServerHttpBoostService::emit(std::size_t& bytes) {
+  boost::system::error_code ec;
+
+  m_response_buffers.clear();
+  if (m_writer.chunked() == false) {
+    m_response_status_code = m_writer.code();
+    head(0, true);
+    m_response_buffers.push_back(boost::asio::buffer(m_response_status_line));
+    m_response_buffers.push_back(boost::asio::buffer(m_response_headers));
+  }
+  chunk();
+
+  // on the executor's thread, like the handler itself (never an io thread)
+  bytes = boost::asio::write(m_sock, m_response_buffers, ec);
+  m_response_buffers.clear();
+  if (ec != boost::system::errc::success) {
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
+
+    return false;
+  }
+
+  return true;
+}
+
+bool ::ServerHttpBoostWriter::emit(std::size_t& bytes) {
+  return m_service->emit(bytes);
+}
+
+unsigned long long ::ServerHttpBoostService::sojourn() {
+#if defined(__linux__)
+  struct tcp_info info;
+  socklen_t len = sizeof(info);
+
+  // msec since the last bytes came in
+  if (getsockopt(m_sock.native_handle(), IPPROTO_TCP, TCP_INFO, &info, &len) == 0) {
+    return static_cast<unsigned long long>(info.tcpi_last_data_recv) * 1000000ULL;
+  }
+#endif
+
+  return m_t_read - m_t_accepted;
+}
+
 void ::ServerHttpBoostService::send_response() {
-  std::ostringstream oss;
+  m_t_handled = ::cb::common::times::monotonic();
 
-  try {
-    m_sock->shutdown(boost::asio::ip::tcp::socket::shutdown_receive);
-  } catch (std::exception& err) {
-    // Transport endpoint is not connected
-    oss.str(""); oss.clear();
-    oss << __FUNCTION__ << ":" << __LINE__ << ": " << err.what();
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+  if (m_streamed == true && m_writer.failed() == true) {
+    // cut short, nothing more to send
+    log_access(m_writer.sent());
 
     return on_finish();
   }
 
-  m_response_headers += std::string("Connection: close").append(delim_line_each);
-  m_response_headers += std::string("Content-Type: text/html; charset=utf-8").append(delim_line_each);
-  m_response_headers += std::string("Content-Length: ") + std::to_string(m_resource_size_bytes).append(delim_line_each);
-  m_response_headers += std::string("Server: Boost.Asio").append(delim_line_each);
-
-  // auto status_line = http_status_table.at(m_response_status_code);
-  const std::string status_line = http_status_table.at(m_response_status_code);
-  m_response_status_line = std::string("HTTP/1.1 ") + status_line + delim_line_each;
-  m_response_headers += delim_line_each;
-  std::vector<boost::asio::const_buffer> response_buffers;
-  response_buffers.push_back(boost::asio::buffer(m_response_status_line));
+  if (m_keep_alive == false) {
+    try {
+      m_sock.shutdown(boost::asio::ip::tcp::socket::shutdown_receive);
+    } catch (std::exception& err) {
+      // Transport endpoint is not connected
+      CB_LOGF_ERROR("{}:{}: {}", __FUNCTION__, __LINE__, err.what());
 
-  if (m_response_headers.length() > 0) {
-    response_buffers.push_back(
-      boost::asio::buffer(m_response_headers));
+      return on_finish();
+    }
   }
 
-  if (m_resource_size_bytes > 0) {
-    response_buffers.push_back(boost::asio::buffer(m_resource_buffer.get(), m_resource_size_bytes));
+  if (m_streamed == true && m_writer.chunked() == true) {
+    // the last chunk and the terminating one (HEAD: the head went out already, no body follows)
+    chunk();
+    if (m_req.method != "HEAD") {
+      m_response_buffers.push_back(boost::asio::buffer("0\r\n\r\n", 5));
+    }
+  } else {
+    head((m_streamed == true) ? m_writer.size() : m_resource_size_bytes, false);
+    m_response_buffers.push_back(boost::asio::buffer(m_response_status_line));
+
+    if (m_response_headers.length() > 0) {
+      m_response_buffers.push_back(
+        boost::asio::buffer(m_response_headers));
+    }
+
+    if (m_req.method == "HEAD") {
+      // Content-Length as for GET, no body: on a kept connection it would pass for the next response
+    } else if (m_streamed == true) {
+      for (auto it = m_writer.segments().begin(); it != m_writer.segments().end(); ++it) {
+        m_response_buffers.push_back(boost::asio::buffer(it->data, it->len));
+      }
+    } else if (m_cached.get() != nullptr) {
+      m_response_buffers.push_back(boost::asio::buffer(m_cached->data(), m_cached->size()));
+    } else if (m_resource_size_bytes > 0) {
+      m_response_buffers.push_back(boost::asio::buffer(m_resource_buffer.data(), m_resource_size_bytes));
+    }
   }
 
   // Initiate asynchronous write operation.
-  boost::asio::async_write(*m_sock.get(), response_buffers, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
+  boost::asio::async_write(m_sock, m_response_buffers, [this](const boost::system::error_code& ec, std::size_t bytes_transferred) {
     on_response_sent(ec, bytes_transferred);
   });
 }
 
 void ::ServerHttpBoostService::on_response_sent(const boost::system::error_code& ec, std::size_t bytes_transferred) {
-  std::ostringstream oss;
-
   if (ec != boost::system::errc::success) {
-    oss << __FUNCTION__ << ":" << __LINE__ << ": " << "Error occured! Error code = " << ec.value() << ". Message: " << ec.message();
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+    CB_LOGF_ERROR("{}:{}: Error occured! Error code = {}. Message: {}", __FUNCTION__, __LINE__, ec.value(), ec.message());
+  }
+
+  log_access(bytes_transferred + m_writer.sent());
+
+  if (ec == boost::system::errc::success && m_keep_alive == true) {
+    // same connection, next request
+    reset_request();
+
+    return read_request();
   }
 
   boost::system::error_code errcode;
-  boost::asio::ip::tcp::endpoint endpoint = m_sock->remote_endpoint(errcode);
+  boost::asio::ip::tcp::endpoint endpoint = m_sock.remote_endpoint(errcode);
   if (errcode == boost::system::errc::success) {
     try {
-      m_sock->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+      m_sock.shutdown(boost::asio::ip::tcp::socket::shutdown_both);
     } catch (std::exception& err) {
       // Transport endpoint is not connected
-      oss.str(""); oss.clear();
-      oss << __FUNCTION__ << ":" << __LINE__ << ": " << err.what();
-      ::cb::common::Logger::log(::cb::common::Logger::eLevel::eError, "%s", oss.str().c_str());
+      CB_LOGF_ERROR("{}:{}: {}", __FUNCTION__, __LINE__, err.what());
     }
   } else {
     // Transport endpoint is not connected (client disconnected already)
-    oss.str(""); oss.clear();
-    oss << "Transport endpoint is not connected - ec: " << errcode;
-    ::cb::common::Logger::log(::cb::common::Logger::eLevel::eDebug, "%s", oss.str().c_str());
+    CB_LOGF_DEBUG("Transport endpoint is not connected - ec: {}:{}", errcode.category().name(), errcode.value());
   }
 
   on_finish();
 }
 
-// Here we perform the cleanup.
+// Here we perform the cleanup: the socket is closed and the object reused
+// (once the idle timer's handler is done with it too).
 void ::ServerHttpBoostService::on_finish() {
-  delete this;
+  release();
+}
+
+void ::ServerHttpBoostService::release() {
+  if (m_holds.fetch_sub(1) == 1) {
+    m_owner->recycle(this);
+  }
+}
+
+void ::ServerHttpBoostService::log_access(std::size_t bytes_out) {
+  unsigned long long now = ::cb::common::times::monotonic();
+  unsigned long long read = (m_t_read == 0) ? m_t_handled : m_t_read;
+
+  latency.record(now - m_t_accepted);
+
+  if (access_log.get() == nullptr) {
+    return;
+  }
+
+  ::cb::library::AccessLog::tagRecord rec;
+
+  rec.utmilli = m_accepted;
+  ::cb::library::AccessLog::assign(rec.method, sizeof(rec.method), m_req.method.data(), m_req.method.size());
+  ::cb::library::AccessLog::assign(rec.path, sizeof(rec.path), m_req.path.data(), m_req.path.size());
+  ::cb::library::AccessLog::assign(rec.remote, sizeof(rec.remote), m_req.remote_addr.data(), m_req.remote_addr.size());
+  rec.port = m_endpoint.port();
+  rec.status = m_response_status_code;
+  rec.bytes_in = m_bytes_in;
+  rec.bytes_out = bytes_out;
+  rec.usec_read = static_cast<unsigned int>((read - m_t_accepted) / 1000);
+  rec.usec_handle = static_cast<unsigned int>((m_t_handled - read) / 1000);
+  rec.usec_write = static_cast<unsigned int>((now - m_t_handled) / 1000);
+  rec.usec_total = static_cast<unsigned int>((now - m_t_accepted) / 1000);
+
+  access_log->log(rec);
 }
 
 //} // namespace
@@ -527,6 +1368,8 @@ ServerHttpBoost::~ServerHttpBoost()
 // Start the server.
 void ServerHttpBoost::start() {
   assert(m_thread_pool_size > 0);
+  // Date headers, access log and log timestamps read the coarse clock.
+  ::cb::common::times::startClock();
   // Create and start Acceptor.
   acc.reset(new ::ServerHttpBoostAcceptor(m_ios, m_port_num));
   acc->start();
@@ -541,16 +1384,25 @@ void ServerHttpBoost::start() {
     m_thread_pool.push_back(std::move(th));
   }
 
-  cb::common::Logger::log(cb::common::Logger::eLevel::eInfo, "Server Started on port %hu with %u threads", m_port_num, m_thread_pool_size);
+  CB_LOGF_INFO("Server Started on port {} with {} threads", m_port_num, m_thread_pool_size);
 }
 
 // Stop the server.
 void ServerHttpBoost::stop() {
   acc->stop();
+  // queued handlers finish first, then the io threads send what they posted before they stop
+  if (::handler_executor.get() != nullptr) {
+    ::handler_executor->stop();
+  }
+  auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(CB_LIBRARY_SERVER_HTTP_BOOST_H_DRAIN);
+  while (::offloaded.load() > 0 && std::chrono::steady_clock::now() < until) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
   m_ios.stop();
   for (auto& th : m_thread_pool) {
     th->join();
   }
+  ::cb::common::times::stopClock();
 }
 
 void ServerHttpBoost::setServiceStatic(const std::string service_static) {
@@ -560,8 +1412,55 @@ void ServerHttpBoost::setServiceStatic(const std::string service_static) {
 }
 
 void ServerHttpBoost::setServiceRouter(const RouterHttp& service_router) {
-  if (::service_router.routes().size() == 0) {
-    ::service_router = service_router;
+  std::unique_ptr<RouterHttp> next(new RouterHttp(service_router));
+
+  // built before it's published, requests only ever see a whole table
+  next->compile();
+  ::service_router.publish(next.release());
+}
+
+void ServerHttpBoost::setServiceRouter(const IRouterHttpStatic& service_router) {
+  ::service_router_static.store(&service_router, std::memory_order_release);
+}
+
+const ::cb::common::Histogram& ServerHttpBoost::latency() {
+  return ::latency;
+}
+
+void ServerHttpBoost::setResponseCache(std::size_t budget) {
+  if (::response_cache.get() == nullptr) {
+    ::response_cache.reset(new ResponseCache(budget));
+  }
+}
+
+const ResponseCache* ServerHttpBoost::cache() {
+  return ::response_cache.get();
+}
+
+void ServerHttpBoost::setAdmissionControl(unsigned int concurrency, double rate, double burst, unsigned int target, unsigned int interval) {
+  if (::admission.get() == nullptr) {
+    ::admission.reset(new AdmissionControl(concurrency, rate, burst, target, interval));
+  }
+}
+
+AdmissionControl* ServerHttpBoost::admission() {
+  return ::admission.get();
+}
+
+void ServerHttpBoost::setHandlerExecutor(unsigned int threads, unsigned int capacity) {
+  if (::handler_executor.get() == nullptr) {
+    ::handler_executor.reset(new ::cb::common::Executor(threads, capacity));
+  }
+}
+
+void ServerHttpBoost::setKeepAlive(unsigned int timeout, unsigned int requests) {
+  ::keep_alive_timeout = timeout;
+  ::keep_alive_requests = std::max<unsigned int>(requests, 1);
+}
+
+void ServerHttpBoost::setAccessLog(const char* filename, AccessLog::eFormat format) {
+  if (::access_log.get() == nullptr) {
+    ::access_log.reset(new AccessLog(filename, format));
   }
 }
 
@@ -4,11 +4,25 @@
 #include <string>
 #include <memory>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <boost/asio.hpp>
 
 #include "include/cb/library/router_http.hpp"
+#include "include/cb/library/router_http_static.hpp"
+#include "include/cb/common/executor.h"
+#include "include/cb/common/histogram.h"
+#include "include/cb/library/access_log.h"
+#include "include/cb/library/admission_control.h"
+#include "include/cb/library/response_cache.h"
+
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_FREE 256 // idle connection objects kept per free list
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_RETAIN 65536 // bytes a recycled connection object keeps per buffer
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_KEEP_ALIVE 5000 // msec a connection may wait for its next request
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_KEEP_ALIVE 100 // requests per connection
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_BODY (1024 * 1024) // request body bytes (Content-Length), 413 past that
+#define CB_LIBRARY_SERVER_HTTP_BOOST_H_DRAIN 5000 // msec stop() waits for the offloaded responses to go out
 
 namespace {
 
@@ -31,7 +45,32 @@ class ServerHttpBoost {
 
   // Definition the services
   void setServiceStatic(const std::string service_static);
+  // replaces the routes, also while the server runs: requests already routed finish on their handlers.
+  // returns once no request reads the previous table anymore (a handler may call it, not a lookup)
   void setServiceRouter(const RouterHttp& service_router);
+  // exact paths fixed at build time, looked up before the router above (which gets the methods they lack). kept by reference (e.g. a static RouterHttpStatic<N>),
+  // replaced the same way: the previous table has to outlive the server
+  void setServiceRouter(const IRouterHttpStatic& service_router);
+  // runs the routes added with offload on threads of their own, queueing at most capacity requests (503 past that).
+  // without it they run on the io threads like the rest, except writer_t routes: those need it (500 without)
+  void setHandlerExecutor(unsigned int threads, unsigned int capacity = CB_COMMON_EXECUTOR_H_LEN_QUEUE);
+  // keeps the responses of routes added with a cache ttl, within budget bytes
+  void setResponseCache(std::size_t budget = CB_LIBRARY_RESPONSE_CACHE_H_LEN_BUDGET);
+  // refuses requests past concurrency in flight (503), past rate per sec (burst at once) from one client (429),
+  // or once they queue longer than target usec (503, CoDel), before they're routed. per route limits through admission()
+  void setAdmissionControl(unsigned int concurrency, double rate = 0, double burst = 0,
+    unsigned int target = CB_LIBRARY_ADMISSION_CONTROL_H_TARGET, unsigned int interval = CB_LIBRARY_ADMISSION_CONTROL_H_INTERVAL);
+  // persistent connections (on by default): unless the client sends "Connection: close", a connection serves up to
+  // requests requests, pipelined ones in order, and is closed after waiting timeout msec for the next. timeout 0: one request each
+  void setKeepAlive(unsigned int timeout = CB_LIBRARY_SERVER_HTTP_BOOST_H_KEEP_ALIVE, unsigned int requests = CB_LIBRARY_SERVER_HTTP_BOOST_H_LEN_KEEP_ALIVE);
+  // one line per request to filename (CLF or JSON), apart from the general log
+  void setAccessLog(const char* filename, AccessLog::eFormat format = AccessLog::eFormat::eCommon);
+  // nsec from accept to the response sent, every server in the process
+  static const ::cb::common::Histogram& latency();
+  // hits / misses / coalesced, ... NULL without setResponseCache()
+  static const ResponseCache* cache();
+  // limit() the routes before start(), stats() any time. NULL without setAdmissionControl()
+  static AdmissionControl* admission();
 
  private:
   unsigned short m_port_num;
@@ -3,10 +3,31 @@
 #include "include/cb/common/types.h"
 #include "router/router_http_test.h"
 
+namespace {
+
+std::string a(const cb::common::types::HttpRequest& req) { return std::string("a"); }
+std::string b(const cb::common::types::HttpRequest& req) { return std::string("b"); }
+std::string c(const cb::common::types::HttpRequest& req) { return std::string("c"); }
+
+constexpr cb::library::tagRouteStatic routes_fixed[] = {
+  CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE("/a", a),
+  CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE("/b", b),
+  CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_ROUTE("/c", c)
+};
+
+} // namespace
+
 RouterHttpTest::RouterHttpTest(void) {
   m_routes = {
-    {"/a", [](const cb::common::types::HttpRequest& req) -> std::string { return std::string("a"); }},
-    {"/b", [](const cb::common::types::HttpRequest& req) -> std::string { return std::string("b"); }},
-    {"/c", [](const cb::common::types::HttpRequest& req) -> std::string { return std::string("c"); }}
+    {"/a", a},
+    {"/b", b},
+    {"/c", c}
   };
-}
\ No newline at end of file
+}
+
+const cb::library::IRouterHttpStatic& RouterHttpTest::fixed(void) {
+  // built by the compiler from C++14 on: no perfect hash search at startup
+  static CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_CONSTEXPR const cb::library::RouterHttpStatic<sizeof(routes_fixed) / sizeof(routes_fixed[0])> rtn(routes_fixed);
+
+  return rtn;
+}
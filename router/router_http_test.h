@@ -2,10 +2,13 @@
 #define ROUTER_ROUTER_HTTP_TEST_H_
 
 #include "include/cb/library/router_http.hpp"
+#include "include/cb/library/router_http_static.hpp"
 
 class RouterHttpTest : public cb::library::RouterHttp {
  public:
    RouterHttpTest(void);
+   // the same routes as a table built at compile time
+   static const cb::library::IRouterHttpStatic& fixed(void);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,83 @@
+/**
+ * log_sink_rotate_test - rotates LogSinkFile segments by size within a period, then across periods
+ *
+ * every line written has to be in the files afterwards, whole and without preallocated zeros
+ * in between; a spare segment retired over a file still mapped used to crash with SIGBUS.
+ *
+ * @usage
+ * log_sink_rotate_test /tmp/empty_directory
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <boost/filesystem.hpp>
+
+#include "include/cb/common/log_sink.h"
+
+int main(int argc, char* argv[]) {
+  int rtn = 0;
+  unsigned long long utmilli = 1700000000ULL / 3600 * 3600 * 1000000; // on the hour
+  unsigned int written = 0;
+  unsigned int found = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s directory\n", argv[0]);
+    return 1;
+  }
+
+  {
+    ::cb::common::LogSinkFile sink(argv[1], 10, 4096);
+    ::cb::common::Logger::tagRecord rec;
+
+    rec.level = ::cb::common::Logger::eLevel::eInfo;
+    for (int period = 0; period < 4; ++period) {
+      // ~6 segments a period
+      for (int i = 0; i < 300; ++i) {
+        rec.utmilli = utmilli + i * 1000;
+        snprintf(rec.contents, sizeof(rec.contents), "period %d line %d", period, i);
+        sink.submit(rec);
+        ++written;
+        if (i % 50 == 0) {
+          // lets the preparer open (and reopen) the next period's spare
+          std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+      }
+      utmilli += 600ULL * 1000000;
+    }
+  }
+
+  boost::filesystem::directory_iterator end;
+  for (boost::filesystem::directory_iterator it(argv[1]); it != end; ++it) {
+    FILE* fp = fopen(it->path().string().c_str(), "rb");
+    char buf[4096];
+    std::size_t len;
+
+    if (fp == NULL) {
+      continue;
+    }
+    while ((len = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      if (memchr(buf, '\0', len) != NULL) {
+        fprintf(stderr, "%s: preallocated zeros left\n", it->path().string().c_str());
+        rtn = 1;
+      }
+      for (std::size_t i = 0; i < len; ++i) {
+        if (buf[i] == '\n') {
+          ++found;
+        }
+      }
+    }
+    fclose(fp);
+  }
+
+  if (found != written) {
+    fprintf(stderr, "%u lines written, %u found\n", written, found);
+    rtn = 1;
+  }
+  printf("%s: %u lines\n", (rtn == 0) ? "ok" : "failed", found);
+
+  return rtn;
+}
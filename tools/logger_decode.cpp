@@ -0,0 +1,36 @@
+/**
+ * logger_decode - prints binary logs (Logger::setBinary) as text
+ *
+ * @usage
+ * logger_decode server.YYYY-MM-DD-HH-MM.blog [...] > server.log
+ */
+
+#include <cstdio>
+
+#include "include/cb/common/logger_binary.h"
+
+int main(int argc, char* argv[]) {
+  int rtn = 0;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file.blog [...]\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    FILE* fp = fopen(argv[i], "rb");
+    if (fp == NULL) {
+      fprintf(stderr, "%s: cannot open\n", argv[i]);
+      rtn = 1;
+      continue;
+    }
+
+    if (::cb::common::binlog::decode(fp, stdout) == false) {
+      fprintf(stderr, "%s: malformed frame\n", argv[i]);
+      rtn = 1;
+    }
+    fclose(fp);
+  }
+
+  return rtn;
+}
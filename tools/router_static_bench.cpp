@@ -0,0 +1,85 @@
+/**
+ * router_static_bench - RouterHttpStatic::find against std::unordered_map::find on the same paths
+ *
+ * prints nsec per lookup for hits and misses, the table built once like a server's would be.
+ *
+ * @usage
+ * router_static_bench [lookups]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "include/cb/common/types.h"
+#include "include/cb/library/router_http_static.hpp"
+
+#define LEN_ROUTES 64
+
+namespace {
+
+std::string handler(const cb::common::types::HttpRequest& /*req*/) {
+  return std::string();
+}
+
+template <typename F>
+double measure(const std::vector<std::string>& paths, unsigned long lookups, F find, unsigned long& found) {
+  auto started = std::chrono::steady_clock::now();
+
+  for (unsigned long i = 0; i < lookups; ++i) {
+    const std::string& path = paths[i % paths.size()];
+    if (find(path) != NULL) {
+      ++found;
+    }
+  }
+
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - started).count() / lookups;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned long lookups = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000000;
+  std::vector<std::string> paths, misses;
+  cb::library::tagRouteStatic routes[LEN_ROUTES];
+  std::unordered_map<std::string, cb::library::RouterHttp::method_t> map;
+  unsigned long found = 0;
+
+  if (lookups == 0) {
+    fprintf(stderr, "usage: %s [lookups]\n", argv[0]);
+    return 1;
+  }
+
+  // paths of the lengths a service has, a few short, most past 8 bytes
+  for (int i = 0; i < LEN_ROUTES; ++i) {
+    paths.push_back("/api/v1/resource/" + std::to_string(i) + ((i % 4 == 0) ? "/items" : ""));
+    misses.push_back("/api/v1/resource/" + std::to_string(i) + "/missing");
+  }
+  for (int i = 0; i < LEN_ROUTES; ++i) {
+    routes[i].path = paths[i].c_str();
+    routes[i].len = paths[i].size();
+    routes[i].handler = handler;
+    routes[i].methods = CB_LIBRARY_ROUTER_HTTP_STATIC_HPP_METHOD(eGet);
+    map[paths[i]] = handler;
+  }
+  static const cb::library::RouterHttpStatic<LEN_ROUTES> table(routes);
+
+  auto find_static = [](const std::string& path) {
+    unsigned short methods;
+    return table.find(path.data(), path.size(), cb::library::RouterHttp::eMethod::eGet, methods);
+  };
+  auto find_map = [&map](const std::string& path) -> cb::library::RouterHttp::method_t {
+    auto it = map.find(path);
+    return (it == map.end()) ? NULL : it->second;
+  };
+
+  printf("%-24s %10s %10s\n", "", "hit", "miss");
+  printf("%-24s %10.2f %10.2f\n", "RouterHttpStatic::find", measure(paths, lookups, find_static, found), measure(misses, lookups, find_static, found));
+  printf("%-24s %10.2f %10.2f\n", "unordered_map::find", measure(paths, lookups, find_map, found), measure(misses, lookups, find_map, found));
+  printf("(nsec per lookup, %lu lookups each, %lu found)\n", lookups, found);
+
+  return (found == 2 * lookups) ? 0 : 1;
+}